@@ -47,8 +47,9 @@ int main() {
                     std::cin >> capacity >> occupied >> typeStr;
                     if (!std::cin) throw std::invalid_argument("Invalid input format.");
 
-                    mgt::VanType type = mgt::StringToType.at(typeStr);
-                    currentVan = mgt::Van(capacity, occupied, type);
+                    std::optional<mgt::VanType> type = mgt::ParseVanType(typeStr);
+                    if (!type) throw std::invalid_argument("Unknown van type.");
+                    currentVan = mgt::Van(capacity, occupied, *type);
                     vanCreated = true;
                     std::cout << "Van created successfully!\n";
                     break;
@@ -0,0 +1,490 @@
+#include "../van/van.hpp"
+#include "../train/train.hpp"
+#include "../train/manifest.hpp"
+#include "../train/snapshot.hpp"
+#include "../train/archive.hpp"
+#include "../train/fleet.hpp"
+#include "../train/concurrent_train.hpp"
+#include "../train/optimizer_cache.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+using namespace mgt;
+
+namespace {
+
+constexpr int64_t MinVans = 10;
+constexpr int64_t MaxVans = 10'000'000;
+
+enum class Mix {
+    Realistic, // mostly seated/economy, a few luxury and restaurant vans, random load
+    Uniform,   // every van a default economy van with the same load: all fractions equal
+    Sorted     // many capacities, vans already in BalanceOccupancy's fraction order
+};
+
+Van RandomVan(std::mt19937_64& gen) {
+    size_t roll = gen() % 100;
+    VanType type = roll < 2 ? VanType::Restaurant : roll < 45 ? VanType::Seated : roll < 90 ? VanType::Economy : VanType::Luxury;
+    size_t capacity = DefaultCapacityOf(type);
+    return Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+}
+
+// Adversarial input for BalanceOccupancy: hundreds of distinct capacities, so fractions
+// repeat (ties at the cut) but are far from all equal, laid out largest fraction first.
+Train MakeSortedTrain(size_t size, std::mt19937_64& gen) {
+    std::vector<Van> vans;
+    vans.reserve(size);
+    size_t occupied = 0, capacity = 0;
+    for (size_t i = 0; i < size; ++i) {
+        size_t seats = 10 + gen() % 991;
+        vans.emplace_back(seats, gen() % (seats + 1), VanType::Seated);
+        occupied += vans.back().GetOccupiedSeats();
+        capacity += seats;
+    }
+    double target = static_cast<double>(occupied) / static_cast<double>(capacity);
+    auto fraction = [target](const Van& van) {
+        double ideal = target * static_cast<double>(van.GetCapacity());
+        return ideal - static_cast<double>(static_cast<size_t>(ideal));
+    };
+    std::stable_sort(vans.begin(), vans.end(), [&](const Van& a, const Van& b) { return fraction(a) > fraction(b); });
+    return Train(vans.data(), vans.size());
+}
+
+Train MakeTrain(size_t size, Mix mix, uint64_t seed = 42) {
+    std::mt19937_64 gen(seed);
+    if (mix == Mix::Sorted)
+        return MakeSortedTrain(size, gen);
+    Train train;
+    for (size_t i = 0; i < size; ++i) {
+        if (mix == Mix::Uniform)
+            train += Van(DefaultCapacityOf(VanType::Economy), 27, VanType::Economy);
+        else
+            train += RandomVan(gen);
+    }
+    return train;
+}
+
+void Sizes(benchmark::internal::Benchmark* bench) {
+    bench->RangeMultiplier(10)->Range(MinVans, MaxVans)->Unit(benchmark::kMicrosecond);
+}
+
+template <Mix mix>
+void BM_SitInMin(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), mix);
+    std::mt19937_64 gen(7);
+    for (auto _ : state) {
+        train.SitInMin(gen() % 4);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SitInMin<Mix::Realistic>)->Apply(Sizes);
+BENCHMARK(BM_SitInMin<Mix::Uniform>)->Apply(Sizes);
+BENCHMARK(BM_SitInMin<Mix::Sorted>)->Apply(Sizes);
+
+void BM_SitInMinIndexed(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    train.EnableSeatIndex();
+    std::mt19937_64 gen(7);
+    for (auto _ : state) {
+        train.SitInMin(gen() % 4);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SitInMinIndexed)->Apply(Sizes);
+
+void BM_SitInMinBatch(benchmark::State& state) {
+    Train source = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    std::mt19937_64 gen(7);
+    std::vector<size_t> groups(4096);
+    for (size_t& group : groups)
+        group = gen() % 4;
+    for (auto _ : state) {
+        state.PauseTiming();
+        Train train = source;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(train.SitInMinBatch(groups));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(groups.size()));
+}
+BENCHMARK(BM_SitInMinBatch)->Apply(Sizes);
+
+void BM_StaffingPercentage(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(train.StaffingPercentage());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StaffingPercentage)->Apply(Sizes);
+
+// Optimizers mutate the train, so every iteration starts from a fresh copy made outside the timer.
+template <Mix mix, void (Train::*pass)()>
+void BM_Optimizer(benchmark::State& state) {
+    Train source = MakeTrain(static_cast<size_t>(state.range(0)), mix);
+    for (auto _ : state) {
+        state.PauseTiming();
+        Train train = source;
+        state.ResumeTiming();
+        (train.*pass)();
+        benchmark::DoNotOptimize(train);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Optimizer<Mix::Realistic, &Train::BalanceOccupancy>)->Name("BM_BalanceOccupancy/Realistic")->Apply(Sizes);
+BENCHMARK(BM_Optimizer<Mix::Uniform, &Train::BalanceOccupancy>)->Name("BM_BalanceOccupancy/Uniform")->Apply(Sizes);
+BENCHMARK(BM_Optimizer<Mix::Sorted, &Train::BalanceOccupancy>)->Name("BM_BalanceOccupancy/Sorted")->Apply(Sizes);
+BENCHMARK(BM_Optimizer<Mix::Realistic, &Train::MinimizeVans>)->Name("BM_MinimizeVans/Realistic")->Apply(Sizes);
+BENCHMARK(BM_Optimizer<Mix::Uniform, &Train::MinimizeVans>)->Name("BM_MinimizeVans/Uniform")->Apply(Sizes);
+BENCHMARK(BM_Optimizer<Mix::Sorted, &Train::MinimizeVans>)->Name("BM_MinimizeVans/Sorted")->Apply(Sizes);
+BENCHMARK(BM_Optimizer<Mix::Realistic, &Train::PlaceRestaurantVanOptimally>)->Name("BM_PlaceRestaurantVanOptimally/Realistic")->Apply(Sizes);
+
+// Same pass drawing its scratch from an arena that is reset between trains, as a worker would run it.
+void BM_BalanceOccupancyArena(benchmark::State& state) {
+    Train source = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    std::pmr::monotonic_buffer_resource arena;
+    for (auto _ : state) {
+        state.PauseTiming();
+        Train train = source;
+        arena.release();
+        state.ResumeTiming();
+        train.BalanceOccupancy(&arena);
+        benchmark::DoNotOptimize(train);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BalanceOccupancyArena)->Apply(Sizes);
+
+// One boarding wave followed by a placement, as the planner runs it, on a consist with one restaurant van.
+template <bool indexed>
+void BM_BoardAndPlace(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Uniform);
+    train += Van(VanType::Restaurant);
+    if (indexed)
+        train.EnablePlacementIndex();
+    std::mt19937_64 gen(7);
+    for (auto _ : state) {
+        train[gen() % train.GetSize()] -= 1;
+        train.PlaceRestaurantVanOptimally();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BoardAndPlace<false>)->Apply(Sizes);
+BENCHMARK(BM_BoardAndPlace<true>)->Apply(Sizes);
+
+void BM_PlaceRestaurantVans(benchmark::State& state) {
+    Train source = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Uniform);
+    for (size_t i = 0; i < 3; ++i)
+        source += Van(VanType::Restaurant);
+    for (auto _ : state) {
+        state.PauseTiming();
+        Train train = source;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(train.PlaceRestaurantVansOptimally());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PlaceRestaurantVans)->Apply(Sizes);
+
+// Adds and removes one van at a time, hovering around a power-of-two size.
+void BM_AddRemoveChurn(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    Van van(VanType::Economy);
+    for (auto _ : state) {
+        train += van;
+        train.RemoveVan(train.GetSize() - 1);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_AddRemoveChurn)->Arg(8)->Arg(64)->Arg(1024)->Arg(1 << 20);
+
+void BM_AppendVans(benchmark::State& state) {
+    Van van(VanType::Seated);
+    for (auto _ : state) {
+        Train train;
+        for (int64_t i = 0; i < state.range(0); ++i)
+            train += van;
+        benchmark::DoNotOptimize(train);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AppendVans)->Apply(Sizes);
+
+void BM_Copy(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    for (auto _ : state) {
+        Train copy(train);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(Van)));
+}
+BENCHMARK(BM_Copy)->Apply(Sizes);
+
+void BM_Move(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    for (auto _ : state) {
+        Train moved(std::move(train));
+        train = std::move(moved);
+        benchmark::DoNotOptimize(train);
+    }
+}
+BENCHMARK(BM_Move)->Arg(MinVans)->Arg(MaxVans);
+
+void BM_VanPrint(benchmark::State& state) {
+    std::mt19937_64 gen(42);
+    Van van = RandomVan(gen);
+    std::ostringstream os;
+    for (auto _ : state) {
+        os.str({});
+        van.Print(os);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VanPrint);
+
+void BM_VanRead(benchmark::State& state) {
+    std::istringstream is;
+    Van van;
+    for (auto _ : state) {
+        is.clear();
+        is.str("13/56 economy");
+        van.Read(is);
+        benchmark::DoNotOptimize(van);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VanRead);
+
+void BM_WriteManifest(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    std::ostringstream os;
+    for (auto _ : state) {
+        os.str({});
+        os << train;
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(os.str().size()));
+}
+BENCHMARK(BM_WriteManifest)->Apply(Sizes);
+
+void BM_ParseManifest(benchmark::State& state) {
+    std::ostringstream os;
+    os << MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    std::string text = os.str();
+    for (auto _ : state) {
+        Train train;
+        benchmark::DoNotOptimize(ParseTrain(text, train));
+        benchmark::DoNotOptimize(train);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_ParseManifest)->Apply(Sizes);
+
+// Start-up from a snapshot file, with and without the full verification pass; compare BM_ParseManifest.
+template <bool verify>
+void BM_OpenSnapshot(benchmark::State& state) {
+    std::string path = "bench_snapshot.bin";
+    WriteSnapshot(path, MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic));
+    for (auto _ : state) {
+        Snapshot snapshot = Snapshot::Open(path, verify);
+        benchmark::DoNotOptimize(snapshot[0].StaffingPercentage());
+    }
+    std::remove(path.c_str());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_OpenSnapshot<true>)->Apply(Sizes);
+BENCHMARK(BM_OpenSnapshot<false>)->Apply(Sizes);
+
+void BM_EncodeArchive(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    const Train* trains[] = {&train};
+    std::vector<uint8_t> bytes;
+    for (auto _ : state) {
+        bytes.clear();
+        EncodeArchive(trains, bytes);
+    }
+    state.counters["bytes_per_van"] = static_cast<double>(bytes.size()) / static_cast<double>(state.range(0));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EncodeArchive)->Apply(Sizes);
+
+void BM_DecodeArchiveBlocks(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    const Train* trains[] = {&train};
+    std::vector<uint8_t> bytes;
+    EncodeArchive(trains, bytes);
+    ArchiveReader reader(bytes);
+    std::vector<size_t> capacities(ArchiveBlockVans), occupied(ArchiveBlockVans);
+    std::vector<VanType> types(ArchiveBlockVans);
+    for (auto _ : state) {
+        for (size_t b = 0; b < reader[0].GetBlockCount(); ++b)
+            benchmark::DoNotOptimize(reader[0].DecodeBlock(b, capacities.data(), occupied.data(), types.data()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DecodeArchiveBlocks)->Apply(Sizes);
+
+void BM_ArchiveStaffing(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    const Train* trains[] = {&train};
+    std::vector<uint8_t> bytes;
+    EncodeArchive(trains, bytes);
+    ArchiveReader reader(bytes);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(reader[0].StaffingPercentage());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ArchiveStaffing)->Apply(Sizes);
+
+// A planning cycle over 2000 short regional trains and a few long ones; the argument is the thread count.
+void BM_FleetBalance(benchmark::State& state) {
+    Fleet source;
+    for (size_t t = 0; t < 2000; ++t)
+        source += MakeTrain(t % 200 == 0 ? 50'000 : 4 + t % 9, Mix::Realistic, t);
+    ThreadPool pool(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Fleet fleet = source;
+        state.ResumeTiming();
+        fleet.BalanceOccupancy(pool);
+        benchmark::DoNotOptimize(fleet);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(source.GetVanCount()));
+}
+BENCHMARK(BM_FleetBalance)->RangeMultiplier(2)->Range(1, 16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// One train holding nearly all the vans, which Fleet splits into chunks over the pool.
+void BM_FleetLargeTrain(benchmark::State& state) {
+    Fleet source;
+    source += MakeTrain(2'000'000, Mix::Realistic);
+    for (size_t t = 0; t < 200; ++t)
+        source += MakeTrain(4 + t % 9, Mix::Realistic, t);
+    ThreadPool pool(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Fleet fleet = source;
+        state.ResumeTiming();
+        fleet.BalanceOccupancy(pool);
+        fleet.PlaceRestaurantVanOptimally(pool);
+        fleet.MinimizeVans(pool);
+        benchmark::DoNotOptimize(fleet);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(source.GetVanCount()));
+}
+BENCHMARK(BM_FleetLargeTrain)->RangeMultiplier(2)->Range(1, 16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Booking front end: every thread books a seat and cancels it again on random vans of one
+// shared 1024-van train, either lock-free or behind a single mutex as callers had to before.
+void BM_SharedBooking(benchmark::State& state) {
+    static ConcurrentTrain shared(MakeTrain(1024, Mix::Uniform));
+    std::mt19937_64 gen(static_cast<uint64_t>(state.thread_index()));
+    for (auto _ : state) {
+        size_t van = shared.SitInMin(1);
+        if (van != ConcurrentTrain::NotSeated)
+            shared.RemovePassengers(gen() % 1024, 1);
+    }
+}
+BENCHMARK(BM_SharedBooking)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_SharedBookingMutex(benchmark::State& state) {
+    static Train shared = MakeTrain(1024, Mix::Uniform);
+    static std::mutex mutex;
+    std::mt19937_64 gen(static_cast<uint64_t>(state.thread_index()));
+    for (auto _ : state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t van = shared.SitInMin(1);
+        if (van != Train::NotSeated)
+            shared[gen() % 1024].RemovePassengers(1);
+    }
+}
+BENCHMARK(BM_SharedBookingMutex)->ThreadRange(1, 8)->UseRealTime();
+
+// Rejected bookings on a full van: the exception path against the std::expected one.
+template <bool Throwing>
+void BM_RejectBooking(benchmark::State& state) {
+    Train train;
+    train += Van(40, 40, VanType::Economy);
+    size_t rejected = 0;
+    for (auto _ : state) {
+        if constexpr (Throwing) {
+            try {
+                train[0].AddPassengers(1);
+            } catch (const std::invalid_argument&) {
+                ++rejected;
+            }
+        } else {
+            rejected += !train.UncheckedAt(0).TryAddPassengers(1);
+        }
+    }
+    benchmark::DoNotOptimize(rejected);
+}
+BENCHMARK(BM_RejectBooking<true>);
+BENCHMARK(BM_RejectBooking<false>);
+
+// Summing occupancy three ways: checked operator[], the van iterators, and the column span.
+template <int Way>
+void BM_SumOccupied(benchmark::State& state) {
+    const Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    for (auto _ : state) {
+        size_t seats = 0;
+        if constexpr (Way == 0) {
+            for (size_t i = 0; i < train.GetSize(); ++i)
+                seats += train[i].GetOccupiedSeats();
+        } else if constexpr (Way == 1) {
+            for (Van van : train)
+                seats += van.GetOccupiedSeats();
+        } else {
+            seats = std::reduce(train.OccupiedSeats().begin(), train.OccupiedSeats().end(), size_t{0});
+        }
+        benchmark::DoNotOptimize(seats);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SumOccupied<0>)->Name("BM_SumOccupied/Index")->Apply(Sizes);
+BENCHMARK(BM_SumOccupied<1>)->Name("BM_SumOccupied/Iterator")->Apply(Sizes);
+BENCHMARK(BM_SumOccupied<2>)->Name("BM_SumOccupied/Column")->Apply(Sizes);
+
+// Decouples the middle 60% of a consist and couples it back, either with EraseRange/InsertAt
+// or by rebuilding the train from a vector as order-preserving callers had to before.
+template <bool Bulk>
+void BM_DecoupleRecouple(benchmark::State& state) {
+    Train train = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    size_t first = train.GetSize() / 5, last = train.GetSize() - first;
+    for (auto _ : state) {
+        std::vector<Van> section(train.begin() + static_cast<std::ptrdiff_t>(first), train.begin() + static_cast<std::ptrdiff_t>(last));
+        if constexpr (Bulk) {
+            train.EraseRange(first, last);
+            train.InsertAt(first, section);
+        } else {
+            std::vector<Van> rest(train.begin(), train.begin() + static_cast<std::ptrdiff_t>(first));
+            rest.insert(rest.end(), train.begin() + static_cast<std::ptrdiff_t>(last), train.end());
+            train = Train(rest.data(), rest.size());
+            rest.insert(rest.begin() + static_cast<std::ptrdiff_t>(first), section.begin(), section.end());
+            train = Train(rest.data(), rest.size());
+        }
+        benchmark::DoNotOptimize(train);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DecoupleRecouple<true>)->Arg(200)->Arg(100'000);
+BENCHMARK(BM_DecoupleRecouple<false>)->Arg(200)->Arg(100'000);
+
+// A planning cycle that balances an unchanged train again: served from the cache after the first run.
+void BM_CachedBalance(benchmark::State& state) {
+    Train source = MakeTrain(static_cast<size_t>(state.range(0)), Mix::Realistic);
+    OptimizerCache cache(4);
+    Train train = source;
+    for (auto _ : state) {
+        train = source;
+        cache.BalanceOccupancy(train);
+        benchmark::DoNotOptimize(train);
+    }
+    state.counters["hits"] = static_cast<double>(cache.GetHits());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CachedBalance)->Apply(Sizes);
+
+} // namespace
@@ -1,8 +1,16 @@
 #include "../van/van.hpp"
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <utility>
 
 using namespace mgt;
 using std::invalid_argument;
@@ -71,9 +79,31 @@ TEST_CASE("Van"){
         REQUIRE_NOTHROW(a.RemovePassengers(40));
         REQUIRE(!a.GetOccupiedSeats());
     }
+
+    SECTION("Type traits"){
+        static_assert(Van(mgt::VanType::Seated).GetCapacity() == 78);
+        static_assert(mgt::ParseVanType("luxury") == mgt::VanType::Luxury);
+        static_assert(!mgt::ParseVanType("sleeper"));
+        for (const mgt::VanTraits& traits : mgt::VanTypeTraits) {
+            REQUIRE(mgt::ParseVanType(traits.name) == traits.type);
+            REQUIRE(mgt::ToString(traits.type) == traits.name);
+            REQUIRE(Van(traits.type).GetCapacity() == traits.defaultCapacity);
+        }
+        REQUIRE(!mgt::ParseVanType(""));
+        REQUIRE(!mgt::ParseVanType("Seated"));
+        REQUIRE(!mgt::ParseVanType("seated "));
+        REQUIRE_THROWS_AS(Van(static_cast<mgt::VanType>(mgt::VanTypeCount)), std::out_of_range);
+    }
 }
 
 #include "../train/train.hpp"
+#include "../train/packed_train.hpp"
+#include "../train/manifest.hpp"
+#include "../train/snapshot.hpp"
+#include "../train/archive.hpp"
+#include "../train/fleet.hpp"
+#include "../train/concurrent_train.hpp"
+#include "../train/optimizer_cache.hpp"
 
 TEST_CASE("Train"){
     SECTION("operator == "){
@@ -153,6 +183,33 @@ TEST_CASE("Train"){
         tr.SitInMin(4);
         REQUIRE(tr[2].GetOccupiedSeats() == 7);
     }
+
+    SECTION("Writes through operator []"){
+        Train tr(Van{20, 5, mgt::VanType::Seated});
+        tr += Van{14, 2, mgt::VanType::Luxury};
+        tr[0].AddPassengers(10);
+        REQUIRE(tr[0].GetOccupiedSeats() == 15);
+        REQUIRE_THROWS_AS(tr[1].SetOccupiedSeats(15), invalid_argument);
+        REQUIRE(tr[1].GetOccupiedSeats() == 2);
+        tr[1] = Van{56, 30, mgt::VanType::Economy};
+        REQUIRE(tr[1] == Van{56, 30, mgt::VanType::Economy});
+        tr[0] = tr[1];
+        REQUIRE(tr[0] == tr[1]);
+        tr[1] -= 40;
+        REQUIRE(!tr[1].GetOccupiedSeats());
+        REQUIRE(tr[0].GetOccupiedSeats() == 30);
+    }
+
+    SECTION("Removing keeps other vans"){
+        Train tr;
+        tr += Van{10, 1, mgt::VanType::Seated};
+        tr += Van{20, 2, mgt::VanType::Economy};
+        tr += Van{30, 3, mgt::VanType::Luxury};
+        tr.RemoveVan(0);
+        REQUIRE(tr.GetSize() == 2);
+        REQUIRE(tr[0] == Van{30, 3, mgt::VanType::Luxury});
+        REQUIRE(tr[1] == Van{20, 2, mgt::VanType::Economy});
+    }
 }
 
 TEST_CASE("Balanced occupancy remains unchanged", "[BalanceOccupancy]") {
@@ -397,3 +454,1282 @@ TEST_CASE("Optimal placement at beginning when left sum is minimal", "[PlaceRest
     REQUIRE(train.GetSize() == 3);
     REQUIRE(train[1].GetType() == VanType::Restaurant);
 }
+
+#include <random>
+
+TEST_CASE("Staffing stats match per-van totals", "[StaffingPercentage]") {
+    std::mt19937 gen(7);
+    Train train;
+    for (size_t i = 0; i < 1003; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = type == VanType::Restaurant ? 0 : gen() % 120;
+        train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+    OccupancyStats stats = train.StaffingPercentage();
+    size_t vans[VanTypeCount]{}, capacity[VanTypeCount]{}, occupied[VanTypeCount]{}, seating = 0;
+    size_t* rates = new size_t[train.GetSize()];
+    train.OccupancyRates(rates);
+    for (size_t i = 0; i < train.GetSize(); ++i) {
+        size_t t = static_cast<size_t>(train[i].GetType());
+        ++vans[t];
+        capacity[t] += train[i].GetCapacity();
+        occupied[t] += train[i].GetOccupiedSeats();
+        seating += train[i].GetCapacity() > 0;
+        REQUIRE(rates[i] == train[i].OccupancyRate());
+    }
+    delete[] rates;
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        REQUIRE(stats.types[t].vans == vans[t]);
+        REQUIRE(stats.types[t].capacity == capacity[t]);
+        REQUIRE(stats.types[t].occupied == occupied[t]);
+    }
+    REQUIRE(stats.seatingVans == seating);
+    REQUIRE(stats.Percentage(VanType::Restaurant) == 0);
+}
+
+TEST_CASE("Staffing stats of a small train", "[StaffingPercentage]") {
+    Train train;
+    train += Van(100, 50, VanType::Economy);
+    train += Van(100, 25, VanType::Economy);
+    train += Van(14, 14, VanType::Luxury);
+    train += Van(0, 0, VanType::Restaurant);
+    OccupancyStats stats = train.StaffingPercentage();
+    REQUIRE(stats[VanType::Economy].vans == 2);
+    REQUIRE(stats.Percentage(VanType::Economy) == 37);
+    REQUIRE(stats.Percentage(VanType::Luxury) == 100);
+    REQUIRE(stats.Percentage(VanType::Seated) == 0);
+    REQUIRE(stats.seatingVans == 3);
+    REQUIRE(stats.TotalCapacity() == 214);
+    REQUIRE(CountSeating(nullptr, 0) == 0);
+}
+
+TEST_CASE("Seat index matches linear SitInMin", "[SitInMin]") {
+    std::mt19937 gen(11);
+    Train plain, indexed;
+    indexed.EnableSeatIndex();
+    REQUIRE(indexed.HasSeatIndex());
+    for (size_t step = 0; step < 3000; ++step) {
+        size_t action = gen() % 10;
+        if (action < 2 || plain.GetSize() == 0) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = type == VanType::Restaurant ? 0 : 10 + gen() % 70;
+            Van van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+            plain += van;
+            indexed += van;
+        } else if (action < 3) {
+            size_t index = gen() % plain.GetSize();
+            plain.RemoveVan(index);
+            indexed.RemoveVan(index);
+        } else if (action < 4) {
+            size_t index = gen() % plain.GetSize(), count = gen() % 20;
+            plain[index] -= count;
+            indexed[index] -= count;
+        } else {
+            size_t group = gen() % 12;
+            plain.SitInMin(group);
+            indexed.SitInMin(group);
+        }
+        REQUIRE(plain == indexed);
+    }
+    indexed.BalanceOccupancy();
+    plain.BalanceOccupancy();
+    indexed.SitInMin(3);
+    plain.SitInMin(3);
+    REQUIRE(plain == indexed);
+    Train copy(indexed);
+    REQUIRE(copy.HasSeatIndex());
+    copy.SitInMin(1000);
+    REQUIRE(copy == indexed);
+    Train bare = indexed.CopyVans();
+    REQUIRE_FALSE(bare.HasSeatIndex());
+    REQUIRE(bare == indexed);
+    REQUIRE(bare.GetContentHash() == indexed.GetContentHash());
+    REQUIRE(bare.StaffingPercentage().TotalOccupied() == indexed.StaffingPercentage().TotalOccupied());
+
+    // Emptying a full van must not need a larger index: it is sized by capacity.
+    Train full;
+    full.EnableSeatIndex();
+    full += Van(50, 50, VanType::Economy);
+    auto van = full[0];
+    STATIC_REQUIRE(noexcept(van -= 50));
+    van -= 50;
+    REQUIRE(full.SitInMin(50) == 0);
+}
+
+TEST_CASE("Batched seating matches one-by-one seating", "[SitInMin]") {
+    std::mt19937 gen(5);
+    Train train;
+    for (size_t i = 0; i < 500; ++i)
+        train += Van(60, gen() % 61, i % 7 ? VanType::Economy : VanType::Luxury);
+    size_t groups[200];
+    for (size_t& group : groups)
+        group = 1 + gen() % 8;
+    groups[17] = 1000;
+
+    Train sequential(train);
+    std::vector<size_t> expected;
+    for (size_t group : groups)
+        expected.push_back(sequential.SitInMin(group));
+
+    std::vector<size_t> placed = train.SitInMinBatch(groups);
+    REQUIRE(placed == expected);
+    REQUIRE(placed[17] == Train::NotSeated);
+    REQUIRE(train == sequential);
+
+    Train small(Van(10, 8, VanType::Seated));
+    size_t few[] = {1, 5, 1};
+    std::vector<size_t> result = small.SitInMinBatch(few);
+    REQUIRE(result == std::vector<size_t>{0, Train::NotSeated, 0});
+    REQUIRE(small[0].GetOccupiedSeats() == 10);
+}
+
+TEST_CASE("MinimizeVans: Large mixed train", "[MinimizeVans]") {
+    std::mt19937 gen(3);
+    Train train;
+    size_t occupied[VanTypeCount] = {};
+    for (size_t i = 0; i < 40000; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = type == VanType::Restaurant ? 0 : 10 + gen() % 90;
+        size_t seats = capacity ? gen() % (capacity / 4 + 1) : 0;
+        occupied[static_cast<size_t>(type)] += seats;
+        train += Van(capacity, seats, type);
+    }
+    OccupancyStats before = train.StaffingPercentage();
+    Train serial(train), paired(train);
+    train.MinimizeVans();
+    serial.MinimizeVans(1);
+    paired.MinimizeVans(2);
+    REQUIRE(serial == train);
+    REQUIRE(paired == train);
+    OccupancyStats after = train.StaffingPercentage();
+    REQUIRE(after[VanType::Restaurant].vans == before[VanType::Restaurant].vans);
+    for (size_t t = 0; t < VanTypeCount; ++t)
+        REQUIRE(after.types[t].occupied == occupied[t]);
+    for (size_t i = 1; i < train.GetSize(); ++i) {
+        REQUIRE(train[i - 1].GetType() <= train[i].GetType());
+        if (train[i - 1].GetType() == train[i].GetType())
+            REQUIRE(train[i - 1].GetCapacity() >= train[i].GetCapacity());
+    }
+    REQUIRE(train.GetSize() < 20000);
+
+    // Packing a nearly empty train gives most of its storage back.
+    Train sparse;
+    for (size_t i = 0; i < 1000; ++i)
+        sparse += Van(56, 1, VanType::Economy);
+    sparse.MinimizeVans();
+    REQUIRE(sparse.GetSize() == 18);
+    REQUIRE(sparse.GetStorageCapacity() == 2 * sparse.GetSize());
+}
+
+// Ties are broken the way the original quicksort left them: here the last van wins.
+TEST_CASE("Equal fractions keep the original tie order", "[BalanceOccupancy]") {
+    Train train;
+    train += Van(10, 10, VanType::Economy);
+    train += Van(10, 0, VanType::Economy);
+    train += Van(10, 0, VanType::Economy);
+    train.BalanceOccupancy();
+    REQUIRE(train[0].GetOccupiedSeats() == 3);
+    REQUIRE(train[1].GetOccupiedSeats() == 3);
+    REQUIRE(train[2].GetOccupiedSeats() == 4);
+}
+
+TEST_CASE("Long uniform consist", "[BalanceOccupancy]") {
+    Train train;
+    for (size_t i = 0; i < 200000; ++i)
+        train += Van(56, i % 3 ? 20 : 21, VanType::Economy);
+    train.BalanceOccupancy();
+    size_t total = 0, minSeats = 56, maxSeats = 0;
+    for (size_t i = 0; i < train.GetSize(); ++i) {
+        total += train[i].GetOccupiedSeats();
+        minSeats = std::min(minSeats, train[i].GetOccupiedSeats());
+        maxSeats = std::max(maxSeats, train[i].GetOccupiedSeats());
+    }
+    REQUIRE(minSeats == 20);
+    REQUIRE(maxSeats == 21);
+    REQUIRE(total == 200000 * 20 + 66667);
+    // All fractions are equal: the last van and then the vans from the front get the extra seats.
+    REQUIRE(train[199999].GetOccupiedSeats() == 21);
+    REQUIRE(train[0].GetOccupiedSeats() == 21);
+    REQUIRE(train[66665].GetOccupiedSeats() == 21);
+    REQUIRE(train[66666].GetOccupiedSeats() == 20);
+}
+
+// Fractions already in order are the original quicksort's quadratic case. Every capacity
+// appears twice and the leftover seats are odd, so a tie straddles the cut and the
+// exact-order path has to run on it.
+TEST_CASE("Pre-sorted fractions with a tie at the cut", "[BalanceOccupancy]") {
+    const size_t PAIRS = 100000;
+    std::mt19937_64 gen(23);
+    std::vector<Van> vans;
+    for (size_t i = 0; i < PAIRS; ++i) {
+        size_t capacity = 100 + i;
+        vans.emplace_back(capacity, gen() % capacity, VanType::Seated);
+        vans.emplace_back(capacity, gen() % capacity, VanType::Seated);
+    }
+    auto ratio = [&] {
+        size_t occupied = 0, capacity = 0;
+        for (const Van& van : vans) {
+            occupied += van.GetOccupiedSeats();
+            capacity += van.GetCapacity();
+        }
+        return std::pair{static_cast<double>(occupied) / capacity, occupied};
+    };
+    auto leftover = [&] {
+        auto [target, occupied] = ratio();
+        for (const Van& van : vans)
+            occupied -= static_cast<size_t>(target * van.GetCapacity());
+        return occupied;
+    };
+    while (leftover() % 2 == 0)
+        vans[0].AddPassengers(1);
+    double target = ratio().first;
+    auto fraction = [target](const Van& van) {
+        double ideal = target * van.GetCapacity();
+        return ideal - static_cast<size_t>(ideal);
+    };
+
+    for (bool descending : {true, false}) {
+        std::stable_sort(vans.begin(), vans.end(), [&](const Van& a, const Van& b) {
+            return descending ? fraction(a) > fraction(b) : fraction(a) < fraction(b);
+        });
+        Train train(vans.data(), vans.size());
+        train.BalanceOccupancy();
+        REQUIRE(train.StaffingPercentage().TotalOccupied() == ratio().second);
+        double lowestRaised = 1, highestKept = 0;
+        for (size_t i = 0; i < train.GetSize(); ++i) {
+            size_t base = static_cast<size_t>(target * vans[i].GetCapacity());
+            REQUIRE(train[i].GetOccupiedSeats() - base <= 1);
+            if (train[i].GetOccupiedSeats() > base)
+                lowestRaised = std::min(lowestRaised, fraction(vans[i]));
+            else
+                highestKept = std::max(highestKept, fraction(vans[i]));
+        }
+        REQUIRE(lowestRaised >= highestKept);
+    }
+}
+
+TEST_CASE("Running totals follow every mutation", "[StaffingPercentage]") {
+    std::mt19937 gen(19);
+    Train train;
+    auto recount = [](const Train& tr) {
+        OccupancyStats stats;
+        for (size_t i = 0; i < tr.GetSize(); ++i) {
+            TypeStats& stat = stats.types[static_cast<size_t>(tr[i].GetType())];
+            ++stat.vans;
+            stat.capacity += tr[i].GetCapacity();
+            stat.occupied += tr[i].GetOccupiedSeats();
+            stats.seatingVans += tr[i].GetCapacity() > 0;
+        }
+        return stats;
+    };
+    for (size_t step = 0; step < 2000; ++step) {
+        size_t action = gen() % 8;
+        if (action < 2 || train.GetSize() == 0) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = type == VanType::Restaurant ? 0 : 10 + gen() % 70;
+            train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+        } else if (action == 2) {
+            train.RemoveVan(gen() % train.GetSize());
+        } else if (action == 3) {
+            train[gen() % train.GetSize()] = Van(VanType::Luxury);
+        } else if (action == 4) {
+            train[gen() % train.GetSize()] -= gen() % 10;
+        } else if (action == 5) {
+            size_t groups[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+            train.SitInMinBatch(groups);
+        } else {
+            train.SitInMin(gen() % 6);
+        }
+        if (step % 500 == 0) {
+            train.BalanceOccupancy();
+            train.PlaceRestaurantVanOptimally();
+        }
+        OccupancyStats expected = recount(train);
+        const OccupancyStats& stats = train.StaffingPercentage();
+        for (size_t t = 0; t < VanTypeCount; ++t) {
+            REQUIRE(stats.types[t].vans == expected.types[t].vans);
+            REQUIRE(stats.types[t].capacity == expected.types[t].capacity);
+            REQUIRE(stats.types[t].occupied == expected.types[t].occupied);
+        }
+        REQUIRE(stats.seatingVans == expected.seatingVans);
+    }
+    train.MinimizeVans();
+    REQUIRE(train.StaffingPercentage().NonLuxuryOccupied() == recount(train).NonLuxuryOccupied());
+    Train moved(std::move(train));
+    REQUIRE(train.StaffingPercentage().TotalCapacity() == 0);
+    REQUIRE(moved.StaffingPercentage().TotalOccupied() == recount(moved).TotalOccupied());
+}
+
+TEST_CASE("Placement index matches a full rescan", "[PlaceRestaurantVanOptimally]") {
+    std::mt19937 gen(23);
+    for (size_t trial = 0; trial < 200; ++trial) {
+        Train plain;
+        size_t size = 1 + gen() % 40;
+        for (size_t i = 0; i < size; ++i) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = type == VanType::Restaurant ? 0 : 1 + gen() % 20;
+            plain += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+        }
+        Train indexed(plain);
+        indexed.EnablePlacementIndex();
+        REQUIRE(indexed.HasPlacementIndex());
+        for (size_t wave = 0; wave < 5; ++wave) {
+            plain.PlaceRestaurantVanOptimally();
+            indexed.PlaceRestaurantVanOptimally();
+            REQUIRE(plain == indexed);
+            size_t group = gen() % 4;
+            plain.SitInMin(group);
+            indexed.SitInMin(group);
+            size_t index = gen() % plain.GetSize();
+            plain[index] -= 3;
+            indexed[index] -= 3;
+            if (plain.GetSize() > 1 && gen() % 3 == 0) {
+                plain.RemoveVan(index);
+                indexed.RemoveVan(index);
+            }
+            plain += Van(VanType::Economy);
+            indexed += Van(VanType::Economy);
+        }
+    }
+}
+
+TEST_CASE("Several restaurant vans split the walking load", "[PlaceRestaurantVansOptimally]") {
+    std::mt19937 gen(29);
+    for (size_t trial = 0; trial < 300; ++trial) {
+        Train train;
+        size_t size = 1 + gen() % 12, restaurants = 1 + gen() % 3;
+        std::vector<size_t> loads;
+        for (size_t i = 0; i < size; ++i) {
+            VanType type = gen() % 4 ? VanType::Economy : VanType::Luxury;
+            size_t seats = gen() % 15;
+            train += Van(14, seats, type);
+            loads.push_back(type == VanType::Luxury ? 0 : seats);
+        }
+        for (size_t r = 0; r < restaurants; ++r)
+            train += Van(VanType::Restaurant);
+
+        // Brute force over every way to put the cuts.
+        size_t best = static_cast<size_t>(-1);
+        std::vector<size_t> cuts(restaurants, 0);
+        while (true) {
+            size_t worst = 0, from = 0;
+            for (size_t t = 0; t <= restaurants; ++t) {
+                size_t to = t < restaurants ? cuts[t] : size, load = 0;
+                for (size_t i = from; i < to; ++i)
+                    load += loads[i];
+                worst = std::max(worst, load);
+                from = to;
+            }
+            best = std::min(best, worst);
+            size_t t = restaurants;
+            while (t > 0 && cuts[t - 1] == size)
+                --t;
+            if (t == 0)
+                break;
+            ++cuts[t - 1];
+            for (size_t u = t; u < restaurants; ++u)
+                cuts[u] = cuts[t - 1];
+        }
+
+        // The placement index answers the same search wherever the restaurants stand.
+        std::vector<Van> vans(train.begin(), train.begin() + static_cast<std::ptrdiff_t>(size));
+        for (size_t r = 0; r < restaurants; ++r)
+            vans.insert(vans.begin() + static_cast<std::ptrdiff_t>(gen() % (vans.size() + 1)), Van(VanType::Restaurant));
+        Train scattered(vans.data(), vans.size());
+        Train indexed(scattered);
+        indexed.EnablePlacementIndex();
+        REQUIRE(indexed.PlaceRestaurantVansOptimally() == best);
+        REQUIRE(scattered.PlaceRestaurantVansOptimally() == best);
+        REQUIRE(indexed == scattered);
+
+        Train single(train);
+        REQUIRE(train.PlaceRestaurantVansOptimally() == best);
+        REQUIRE(train.GetSize() == size + restaurants);
+        size_t load = 0, seen = 0;
+        for (size_t i = 0; i < train.GetSize(); ++i) {
+            if (train[i].GetType() == VanType::Restaurant) {
+                load = 0;
+                continue;
+            }
+            REQUIRE(train[i].GetOccupiedSeats() == single[seen].GetOccupiedSeats());
+            load += loads[seen++];
+            REQUIRE(load <= best);
+        }
+        if (restaurants == 1) {
+            single.PlaceRestaurantVanOptimally();
+            REQUIRE(single == train);
+        }
+    }
+}
+
+TEST_CASE("Storage growth") {
+    SECTION("Reserve allocates once") {
+        Train train;
+        train.Reserve(100);
+        REQUIRE(train.GetStorageCapacity() == 100);
+        for (size_t i = 0; i < 100; ++i)
+            train += Van(VanType::Seated);
+        REQUIRE(train.GetStorageCapacity() == 100);
+    }
+    SECTION("Churn at a power of two keeps the storage") {
+        Train train;
+        for (size_t i = 0; i <= 4 * Train::InlineVans; ++i)
+            train += Van(VanType::Economy);
+        size_t capacity = train.GetStorageCapacity();
+        for (size_t i = 0; i < 10; ++i) {
+            train.RemoveVan(train.GetSize() - 1);
+            REQUIRE(train.GetStorageCapacity() == capacity);
+            train += Van(VanType::Economy);
+            REQUIRE(train.GetStorageCapacity() == capacity);
+        }
+        while (train.GetSize() > 1)
+            train.RemoveVan(0);
+        REQUIRE(train.GetStorageCapacity() == Train::InlineVans);
+    }
+    SECTION("ShrinkToFit and Append") {
+        std::vector<Van> vans(Train::InlineVans + 3, Van(10, 3, VanType::Seated));
+        vans.back() = Van(20, 20, VanType::Luxury);
+        Train train(Van(VanType::Economy));
+        train.Append(vans);
+        REQUIRE(train.GetSize() == Train::InlineVans + 4);
+        REQUIRE(train.GetStorageCapacity() == Train::InlineVans + 4);
+        REQUIRE(train[Train::InlineVans + 3] == vans.back());
+        REQUIRE(train.StaffingPercentage().TotalOccupied() == 3 * (Train::InlineVans + 2) + 20);
+        train.Reserve(256);
+        train.ShrinkToFit();
+        REQUIRE(train.GetStorageCapacity() == Train::InlineVans + 4);
+        REQUIRE(train[1] == vans[0]);
+        while (train.GetSize() > 2)
+            train.RemoveVan(train.GetSize() - 1);
+        train.ShrinkToFit();
+        REQUIRE(train.GetStorageCapacity() == Train::InlineVans);
+        REQUIRE(train[1] == vans[0]);
+    }
+}
+
+TEST_CASE("Short trains stay inline") {
+    std::pmr::monotonic_buffer_resource arena(std::pmr::null_memory_resource());
+    Train train(&arena);
+    for (size_t i = 0; i < Train::InlineVans; ++i)
+        train += Van(10, i % 11, VanType::Seated);
+    REQUIRE(train.GetStorageCapacity() == Train::InlineVans);
+    Train copy(train, &arena), moved(std::move(copy));
+    REQUIRE(moved == train);
+    REQUIRE(copy.GetSize() == 0);
+    copy += Van(VanType::Luxury);
+    moved = std::move(copy);
+    REQUIRE(moved.GetSize() == 1);
+    REQUIRE(moved[0] == Van(VanType::Luxury));
+    REQUIRE_THROWS_AS(train += Van(VanType::Economy), std::bad_alloc);
+
+    Train large;
+    for (size_t i = 0; i < 3 * Train::InlineVans; ++i)
+        large += Van(VanType::Economy);
+    Train target(train);
+    target = std::move(large);
+    REQUIRE(target.GetSize() == 3 * Train::InlineVans);
+    REQUIRE(large.GetSize() == 0);
+    large = target;
+    REQUIRE(large == target);
+    large = train;
+    REQUIRE(large == train);
+    REQUIRE(large.StaffingPercentage().TotalOccupied() == train.StaffingPercentage().TotalOccupied());
+}
+
+TEST_CASE("Memory resources") {
+    alignas(std::max_align_t) std::byte storage[1 << 14], scratchStorage[1 << 14];
+    std::pmr::monotonic_buffer_resource arena(storage, sizeof(storage), std::pmr::null_memory_resource());
+    std::pmr::monotonic_buffer_resource scratch(scratchStorage, sizeof(scratchStorage), std::pmr::null_memory_resource());
+    std::mt19937_64 gen(11);
+    Train train(&arena);
+    for (size_t i = 0; i < 100; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+    REQUIRE(train.GetMemoryResource() == &arena);
+    Train reference(train);
+    REQUIRE(reference.GetMemoryResource() == std::pmr::get_default_resource());
+    REQUIRE(reference == train);
+
+    train.BalanceOccupancy(&scratch);
+    reference.BalanceOccupancy();
+    REQUIRE(train == reference);
+    scratch.release();
+    train.PlaceRestaurantVanOptimally(&scratch);
+    reference.PlaceRestaurantVanOptimally();
+    REQUIRE(train == reference);
+    scratch.release();
+    REQUIRE(train.PlaceRestaurantVansOptimally(&scratch) == reference.PlaceRestaurantVansOptimally());
+    REQUIRE(train == reference);
+
+    Train moved(std::move(train));
+    REQUIRE(moved.GetMemoryResource() == &arena);
+    std::istringstream is("12/40 seated");
+    moved.Read(is);
+    REQUIRE(moved.GetMemoryResource() == &arena);
+    REQUIRE(moved.GetSize() == 1);
+}
+
+TEST_CASE("Packed vans") {
+    SECTION("Round trip and invariants") {
+        PackedVan van(Van(56, 13, VanType::Economy));
+        REQUIRE(sizeof(van) == 4);
+        REQUIRE(van.GetCapacity() == 56);
+        REQUIRE(van.GetOccupiedSeats() == 13);
+        REQUIRE(van.GetType() == VanType::Economy);
+        REQUIRE(van.ToVan() == Van(56, 13, VanType::Economy));
+        REQUIRE(PackedVan().ToVan() == Van());
+        REQUIRE(PackedVan(PackedVan::MaxSeats, PackedVan::MaxSeats, VanType::Luxury).GetOccupiedSeats() == PackedVan::MaxSeats);
+        REQUIRE_THROWS_AS(PackedVan(Van(PackedVan::MaxSeats + 1, 0, VanType::Seated)), std::out_of_range);
+        REQUIRE_THROWS_AS(PackedVan(10, 11, VanType::Seated), std::invalid_argument);
+        REQUIRE_THROWS_AS(PackedVan(10, 0, VanType::Restaurant), std::invalid_argument);
+        REQUIRE_THROWS_AS(van.SetOccupiedSeats(57), std::invalid_argument);
+        REQUIRE_THROWS_AS(van.SetCapacity(12), std::invalid_argument);
+        REQUIRE_THROWS_AS(van.SetCapacity(PackedVan::MaxSeats + 1), std::out_of_range);
+        REQUIRE_THROWS_AS(van.SetType(VanType::Restaurant), std::invalid_argument);
+        van.SetCapacity(PackedVan::MaxSeats);
+        van.SetOccupiedSeats(40);
+        van.SetType(VanType::Seated);
+        REQUIRE(van.ToVan() == Van(PackedVan::MaxSeats, 40, VanType::Seated));
+    }
+    SECTION("Packed trains") {
+        std::mt19937_64 gen(5);
+        Train train;
+        for (size_t i = 0; i < 200; ++i) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = DefaultCapacityOf(type);
+            train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+        }
+        PackedTrain packed(train);
+        REQUIRE(packed.GetSize() == train.GetSize());
+        REQUIRE(packed.Vans().size_bytes() == 4 * train.GetSize());
+        Train unpacked = packed.Unpack();
+        REQUIRE(unpacked == train);
+        REQUIRE(unpacked.StaffingPercentage().TotalOccupied() == train.StaffingPercentage().TotalOccupied());
+        packed[3].SetOccupiedSeats(0);
+        REQUIRE(packed[3].GetOccupiedSeats() == 0);
+        REQUIRE_THROWS_AS(packed[packed.GetSize()], std::out_of_range);
+        train += Van(PackedVan::MaxSeats + 1, 0, VanType::Seated);
+        REQUIRE_THROWS_AS(PackedTrain(train), std::out_of_range);
+    }
+}
+
+TEST_CASE("Manifests") {
+    std::mt19937_64 gen(9);
+    Train train;
+    for (size_t i = 0; i < 300; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+    std::ostringstream os;
+    os << train;
+    std::string text = os.str();
+
+    SECTION("Round trip") {
+        Train parsed;
+        REQUIRE(ParseTrain(text, parsed));
+        REQUIRE(parsed == train);
+        std::istringstream is(" " + text + "\n");
+        Train read;
+        REQUIRE(ReadTrain(is, read));
+        REQUIRE(read == train);
+        std::istringstream stream(text + " 3/14 luxury");
+        Train streamed(Van(VanType::Seated));
+        stream >> streamed;
+        REQUIRE(stream);
+        REQUIRE(streamed == train);
+        REQUIRE(streamed.StaffingPercentage().TotalOccupied() == train.StaffingPercentage().TotalOccupied());
+        Van next;
+        REQUIRE(stream >> next);
+        REQUIRE(next == Van(14, 3, VanType::Luxury));
+
+        // Longer than Read's buffer, so the manifest arrives in several pieces.
+        Train longer(train);
+        std::vector<Van> vans(train.begin(), train.end());
+        for (size_t copy = 0; copy < 3; ++copy)
+            longer.InsertAt(longer.GetSize(), vans);
+        std::ostringstream longText;
+        longText << longer;
+        REQUIRE(longText.str().size() > 4 * 4096 / 3);
+        std::istringstream longStream(longText.str());
+        Train longRead;
+        REQUIRE(longStream >> longRead);
+        REQUIRE(longRead == longer);
+    }
+    SECTION("Chunks split anywhere") {
+        std::string small = "{ 12/78 seated ,0/0 restaurant,\n 3/14   luxury }  ";
+        for (size_t chunk = 1; chunk <= small.size(); ++chunk) {
+            Train parsed;
+            ManifestParser parser(parsed);
+            for (size_t pos = 0; pos < small.size(); pos += chunk)
+                REQUIRE(parser.Feed(std::string_view(small).substr(pos, chunk)));
+            REQUIRE(parser.Finish());
+            REQUIRE(parsed.GetSize() == 3);
+            REQUIRE(parsed[2] == Van(14, 3, VanType::Luxury));
+        }
+        Train empty;
+        REQUIRE(ParseTrain("{}", empty));
+        REQUIRE(empty.GetSize() == 0);
+
+        // Long whitespace runs are not tokens and must not hit the carry limit.
+        std::string gap(10000, ' ');
+        std::string spaced = gap + "{" + gap + "12/78" + gap + "seated" + gap + "," + gap + "3/14\nluxury}" + gap;
+        for (size_t chunk : {size_t{1}, size_t{7}, size_t{4096}}) {
+            Train parsed;
+            ManifestParser parser(parsed);
+            for (size_t pos = 0; pos < spaced.size(); pos += chunk)
+                REQUIRE(parser.Feed(std::string_view(spaced).substr(pos, chunk)));
+            REQUIRE(parser.Finish());
+            REQUIRE(parsed.GetSize() == 2);
+            REQUIRE(parsed[1] == Van(14, 3, VanType::Luxury));
+        }
+        std::string badType = "{" + gap + "12/78" + gap + "sleeper}";
+        Train parsed;
+        ManifestParser parser(parsed);
+        for (size_t pos = 0; pos < badType.size(); pos += 5)
+            parser.Feed(std::string_view(badType).substr(pos, 5));
+        ParseStatus status = parser.Finish();
+        REQUIRE(!status);
+        REQUIRE(status.position == badType.find("sleeper"));
+    }
+    SECTION("Errors report positions") {
+        auto errorAt = [](std::string_view manifest) {
+            Train parsed;
+            ParseStatus status = ParseTrain(manifest, parsed);
+            REQUIRE(!status);
+            return status.position;
+        };
+        REQUIRE(errorAt("12/78 seated") == 0);
+        REQUIRE(errorAt("{12/78 seated, 1/0 restaurant}") == 15);
+        REQUIRE(errorAt("{12/78 seated, 5/14 sleeper}") == 20);
+        REQUIRE(errorAt("{12/78 seated 5/14 luxury}") == 14);
+        REQUIRE(errorAt("{12-78 seated}") == 3);
+        REQUIRE(errorAt("{99999999999999999999999/1 seated}") == 1);
+        REQUIRE(errorAt("{12/78 seated,") == 14);
+        REQUIRE(errorAt("{12/78 seated} x") == 15);
+
+        Train partial(train);
+        REQUIRE(!ParseTrain("{12/78 seated, 3/14 luxury, 1/0 restaurant}", partial));
+        REQUIRE(partial == train);
+        std::istringstream broken("{12/78 seated, 3/14 luxury");
+        REQUIRE(!ReadTrain(broken, partial));
+        REQUIRE(partial == train);
+        Train rejected;
+        REQUIRE(std::string_view(ParseTrain("{80/78 seated}", rejected).message) == Describe(VanError::OverCapacity));
+
+        std::istringstream is("{12/78 seated, 80/78 seated}");
+        Train kept(train);
+        is >> kept;
+        REQUIRE(!is);
+        REQUIRE(kept == train);
+    }
+}
+
+TEST_CASE("Formatting") {
+    REQUIRE(std::format("{}", Van(56, 13, VanType::Economy)) == "13/56 economy");
+    Train empty;
+    std::ostringstream os;
+    os << empty;
+    REQUIRE(os.str() == "{}");
+    REQUIRE(std::format("{}", empty) == "{}");
+
+    Train train;
+    for (size_t i = 0; i < 50; ++i)
+        train += Van(100000 + i, i, i % 2 ? VanType::Seated : VanType::Luxury);
+    train += Van(VanType::Restaurant);
+    os.str({});
+    os << train;
+    REQUIRE(std::format("{}", train) == os.str());
+    Train parsed;
+    REQUIRE(ParseTrain(os.str(), parsed));
+    REQUIRE(parsed == train);
+
+    for (size_t size : {ManifestWriter::MinBuffer, ManifestWriter::MinBuffer + 7, size_t{4096}}) {
+        std::string text, buffer(size, '\0');
+        ManifestWriter writer(train);
+        while (size_t length = writer.Write(buffer))
+            text.append(buffer, 0, length);
+        REQUIRE(writer.Done());
+        REQUIRE(text == os.str());
+    }
+}
+
+TEST_CASE("Snapshots") {
+    std::mt19937_64 gen(13);
+    Train first, second, empty;
+    for (size_t i = 0; i < 1000; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        first += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+    for (size_t i = 0; i < 7; ++i)
+        second += Van(10, i, VanType::Seated);
+    std::string path = "snapshot_test.bin";
+    const Train* trains[] = {&first, &empty, &second};
+    WriteSnapshot(path, trains);
+
+    SECTION("Views match the trains") {
+        Snapshot snapshot = Snapshot::Open(path);
+        REQUIRE(snapshot.GetTrainCount() == 3);
+        for (size_t t = 0; t < 3; ++t) {
+            const Train& train = *trains[t];
+            TrainView view = snapshot[t];
+            REQUIRE(view.GetSize() == train.GetSize());
+            REQUIRE(view.ToTrain() == train);
+            for (size_t i = 0; i < train.GetSize(); i += 17)
+                REQUIRE(view[i] == train[i]);
+            OccupancyStats stats = view.StaffingPercentage();
+            for (size_t type = 0; type < VanTypeCount; ++type) {
+                REQUIRE(stats.types[type].vans == train.StaffingPercentage().types[type].vans);
+                REQUIRE(stats.types[type].occupied == train.StaffingPercentage().types[type].occupied);
+            }
+            REQUIRE(stats.seatingVans == train.StaffingPercentage().seatingVans);
+            for (size_t seats = 0; seats < 80; seats += 9)
+                REQUIRE(view.FindBestFit(seats) == train.FindBestFit(seats));
+        }
+        REQUIRE_THROWS_AS(snapshot[3], std::out_of_range);
+        Snapshot moved(std::move(snapshot));
+        REQUIRE(moved[2][6] == Van(10, 6, VanType::Seated));
+    }
+    SECTION("Corruption is detected") {
+        {
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(sizeof(SnapshotHeader) + 3 * sizeof(uint64_t) + sizeof(SnapshotTrainHeader) + 5);
+            file.put('\x7f');
+        }
+        REQUIRE_THROWS_AS(Snapshot::Open(path), std::invalid_argument);
+        REQUIRE_NOTHROW(Snapshot::Open(path, false));
+        {
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(offsetof(SnapshotHeader, typeCount));
+            file.put(static_cast<char>(VanTypeCount + 1));
+        }
+        REQUIRE_THROWS_AS(Snapshot::Open(path, false), std::invalid_argument);
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file << "{12/78 seated}";
+        }
+        REQUIRE_THROWS_AS(Snapshot::Open(path, false), std::invalid_argument);
+        REQUIRE_THROWS_AS(Snapshot::Open("missing_snapshot.bin"), std::runtime_error);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Archives") {
+    std::mt19937_64 gen(17);
+    Train mixed, uniform, odd, empty;
+    for (size_t i = 0; i < 3000; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = gen() % 4 ? DefaultCapacityOf(type) : (type == VanType::Restaurant ? 0 : gen() % 200);
+        mixed += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+    for (size_t i = 0; i < 5000; ++i)
+        uniform += Van(56, 27, VanType::Economy);
+    odd += Van(~size_t{0}, ~size_t{0}, VanType::Luxury);
+    odd += Van(~size_t{0}, 0, VanType::Luxury);
+    odd += Van(VanType::Restaurant);
+
+    const Train* trains[] = {&mixed, &uniform, &empty, &odd};
+    std::vector<uint8_t> bytes;
+    EncodeArchive(trains, bytes);
+    ArchiveReader reader(bytes);
+    REQUIRE(reader.GetTrainCount() == 4);
+    for (size_t t = 0; t < 4; ++t) {
+        ArchivedTrain archived = reader[t];
+        REQUIRE(archived.GetSize() == trains[t]->GetSize());
+        REQUIRE(archived.Decode() == *trains[t]);
+        OccupancyStats stats = archived.StaffingPercentage();
+        const OccupancyStats& expected = trains[t]->StaffingPercentage();
+        REQUIRE(stats.seatingVans == expected.seatingVans);
+        for (size_t type = 0; type < VanTypeCount; ++type) {
+            REQUIRE(stats.types[type].vans == expected.types[type].vans);
+            REQUIRE(stats.types[type].capacity == expected.types[type].capacity);
+            REQUIRE(stats.types[type].occupied == expected.types[type].occupied);
+        }
+    }
+    REQUIRE(reader[1].GetBlockCount() == (5000 + ArchiveBlockVans - 1) / ArchiveBlockVans);
+
+    std::vector<uint8_t> uniformOnly;
+    const Train* single[] = {&uniform};
+    EncodeArchive(single, uniformOnly);
+    REQUIRE(uniformOnly.size() < uniform.GetSize() / 4);
+    uniformOnly[12] = static_cast<uint8_t>(VanTypeCount + 1); // the recorded van type count
+    REQUIRE_THROWS_AS(ArchiveReader(uniformOnly), std::invalid_argument);
+
+    bytes.resize(bytes.size() - 1);
+    REQUIRE_THROWS_AS(ArchiveReader(bytes), std::invalid_argument);
+    bytes[0] = 'X';
+    REQUIRE_THROWS_AS(ArchiveReader(bytes), std::invalid_argument);
+}
+
+TEST_CASE("Thread pool") {
+    for (size_t threads : {1, 2, 5}) {
+        ThreadPool pool(threads);
+        REQUIRE(pool.GetThreadCount() == threads);
+        std::vector<std::atomic<size_t>> hits(1000);
+        for (size_t round = 0; round < 3; ++round)
+            pool.ParallelFor(hits.size(), [&](size_t i) { hits[i].fetch_add(1); });
+        for (const std::atomic<size_t>& hit : hits)
+            REQUIRE(hit.load() == 3);
+        REQUIRE_THROWS_AS(pool.ParallelFor(50, [](size_t i) {
+            if (i == 17)
+                throw std::out_of_range("boom");
+        }), std::out_of_range);
+        pool.ParallelFor(0, [](size_t) {});
+    }
+}
+
+TEST_CASE("Optimizers on a thread pool") {
+    std::mt19937_64 gen(31);
+    Train train;
+    for (size_t i = 0; i < 100000; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+    for (bool indexed : {false, true}) {
+        if (indexed)
+            train.EnablePlacementIndex();
+        Train serial = train;
+        serial.PlaceRestaurantVanOptimally();
+        serial.BalanceOccupancy();
+        serial.MinimizeVans();
+        for (size_t threads : {1, 3, 8}) {
+            ThreadPool pool(threads);
+            Train pooled = train;
+            pooled.PlaceRestaurantVanOptimally(pool);
+            REQUIRE(pooled.GetSize() == train.GetSize());
+            pooled.BalanceOccupancy(pool);
+            pooled.MinimizeVans(pool);
+            REQUIRE(pooled == serial);
+            REQUIRE(pooled.GetContentHash() == serial.GetContentHash());
+            REQUIRE(pooled.StaffingPercentage().seatingVans == serial.StaffingPercentage().seatingVans);
+        }
+    }
+}
+
+TEST_CASE("Fleet") {
+    std::mt19937_64 gen(23);
+    Fleet fleet;
+    for (size_t t = 0; t < 60; ++t) {
+        Train train;
+        size_t size = t % 10 == 0 ? 20000 + gen() % 5000 : gen() % 40;
+        for (size_t i = 0; i < size; ++i) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = DefaultCapacityOf(type);
+            train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+        }
+        fleet += std::move(train);
+    }
+    size_t vans = 0;
+    OccupancyStats expected;
+    for (size_t t = 0; t < fleet.GetSize(); ++t) {
+        vans += fleet[t].GetSize();
+        for (size_t type = 0; type < VanTypeCount; ++type)
+            expected.types[type].occupied += fleet[t].StaffingPercentage().types[type].occupied;
+    }
+    REQUIRE(fleet.GetVanCount() == vans);
+    for (size_t type = 0; type < VanTypeCount; ++type)
+        REQUIRE(fleet.StaffingPercentage().types[type].occupied == expected.types[type].occupied);
+    {
+        ThreadPool pool(4);
+        OccupancyStats serial = fleet.StaffingPercentage(), pooled = fleet.StaffingPercentage(pool);
+        REQUIRE(pooled.seatingVans == serial.seatingVans);
+        for (size_t type = 0; type < VanTypeCount; ++type) {
+            REQUIRE(pooled.types[type].vans == serial.types[type].vans);
+            REQUIRE(pooled.types[type].capacity == serial.types[type].capacity);
+            REQUIRE(pooled.types[type].occupied == serial.types[type].occupied);
+        }
+    }
+
+    Fleet sequential = fleet;
+    for (size_t t = 0; t < sequential.GetSize(); ++t) {
+        sequential[t].BalanceOccupancy();
+        sequential[t].PlaceRestaurantVanOptimally();
+        sequential[t].MinimizeVans();
+    }
+    for (size_t threads : {1, 3, 8}) {
+        ThreadPool pool(threads);
+        Fleet parallel = fleet;
+        parallel.BalanceOccupancy(pool);
+        parallel.PlaceRestaurantVanOptimally(pool);
+        parallel.MinimizeVans(pool);
+        for (size_t t = 0; t < parallel.GetSize(); ++t)
+            REQUIRE(parallel[t] == sequential[t]);
+    }
+    {
+        // One train holding most of the fleet's vans is split across the pool.
+        Train large;
+        for (size_t i = 0; i < 200000; ++i) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = DefaultCapacityOf(type);
+            large += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+        }
+        Fleet dominated;
+        dominated += large;
+        dominated += fleet[1];
+        large.BalanceOccupancy();
+        large.PlaceRestaurantVanOptimally();
+        large.MinimizeVans();
+        ThreadPool pool(4);
+        dominated.BalanceOccupancy(pool);
+        dominated.PlaceRestaurantVanOptimally(pool);
+        dominated.MinimizeVans(pool);
+        REQUIRE(dominated[0] == large);
+        REQUIRE(dominated[0].GetContentHash() == large.GetContentHash());
+        REQUIRE(dominated[1] == sequential[1]);
+    }
+    fleet.RemoveTrain(0);
+    REQUIRE(fleet.GetSize() == 59);
+    REQUIRE_THROWS_AS(fleet[59], std::out_of_range);
+}
+
+TEST_CASE("Concurrent booking") {
+    std::mt19937_64 gen(29);
+    Train train;
+    for (size_t i = 0; i < 300; ++i) {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    }
+
+    SECTION("Single thread matches Train") {
+        ConcurrentTrain shared(train);
+        REQUIRE(shared.ToTrain() == train);
+        for (size_t i = 0; i < 500; ++i) {
+            size_t group = 1 + gen() % 6;
+            REQUIRE(shared.SitInMin(group) == train.SitInMin(group));
+        }
+        shared += Van(40, 0, VanType::Economy);
+        shared.RemoveVan(3);
+        train += Van(40, 0, VanType::Economy);
+        train.RemoveVan(3);
+        REQUIRE(shared.ToTrain() == train);
+        REQUIRE(shared.StaffingPercentage().TotalOccupied() == train.StaffingPercentage().TotalOccupied());
+        REQUIRE_THROWS_AS(shared.AddPassengers(0, shared[0].GetCapacity() + 1), std::invalid_argument);
+        shared.RemovePassengers(0, 1000);
+        REQUIRE(shared[0].GetOccupiedSeats() == 0);
+        REQUIRE_THROWS_AS(shared[shared.GetSize()], std::out_of_range);
+        REQUIRE_THROWS_AS(shared.RemoveVan(shared.GetSize()), std::out_of_range);
+    }
+
+    SECTION("Bookings from many threads") {
+        ConcurrentTrain shared(train);
+        size_t before = shared.StaffingPercentage().TotalOccupied();
+        size_t free = train.StaffingPercentage().TotalCapacity() - before;
+        std::atomic<size_t> seated{0};
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&] {
+                while (shared.SitInMin(1) != ConcurrentTrain::NotSeated)
+                    seated.fetch_add(1);
+            });
+        }
+        // Structural changes run alongside the bookings; the vans added are full.
+        for (size_t i = 0; i < 50; ++i) {
+            shared += Van(30, 30, VanType::Seated);
+            shared.RemoveVan(shared.GetSize() - 1);
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        REQUIRE(seated.load() == free);
+        Train result = shared.ToTrain();
+        REQUIRE(result.GetSize() == train.GetSize());
+        for (size_t i = 0; i < result.GetSize(); ++i)
+            REQUIRE(result[i].GetOccupiedSeats() == result[i].GetCapacity());
+    }
+}
+
+TEST_CASE("Non-throwing API") {
+    SECTION("Van") {
+        REQUIRE(Van::TryCreate(10, 4, VanType::Seated).value() == Van(10, 4, VanType::Seated));
+        REQUIRE(Van::TryCreate(10, 11, VanType::Seated).error() == VanError::OverCapacity);
+        REQUIRE(Van::TryCreate(5, 0, VanType::Restaurant).error() == VanError::RestaurantCapacity);
+
+        Van van(10, 8, VanType::Economy);
+        REQUIRE(van.TryAddPassengers(3).error() == VanError::OverCapacity);
+        REQUIRE(van.GetOccupiedSeats() == 8);
+        REQUIRE(van.TryAddPassengers(2));
+        REQUIRE(van.GetOccupiedSeats() == 10);
+        REQUIRE(van.TryAddPassengers(std::numeric_limits<size_t>::max()).error() == VanError::OverCapacity);
+        REQUIRE(van.TrySetCapacity(9).error() == VanError::OverNewCapacity);
+        REQUIRE(van.TrySetType(VanType::Restaurant).error() == VanError::RestaurantCapacity);
+        REQUIRE(van.TrySetOccupiedSeats(11).error() == VanError::OverCapacity);
+        REQUIRE(van == Van(10, 10, VanType::Economy));
+
+        Van other(10, 0, VanType::Luxury);
+        REQUIRE(van.TryTransfer(other).error() == VanError::TypeMismatch);
+        REQUIRE(other.GetOccupiedSeats() == 0);
+
+        // The throwing API reports the same conditions with the same exceptions.
+        REQUIRE_THROWS_AS(van.AddPassengers(1), std::invalid_argument);
+        REQUIRE_THROWS_AS(van >> other, std::invalid_argument);
+        REQUIRE_THROWS_AS(ThrowVanError(VanError::IndexOutOfRange), std::out_of_range);
+    }
+
+    SECTION("Train") {
+        Train train;
+        train += Van(10, 9, VanType::Seated);
+        train += Van(20, 5, VanType::Seated);
+        REQUIRE(train.TryAt(2).error() == VanError::IndexOutOfRange);
+        REQUIRE(std::as_const(train).TryAt(1).value() == Van(20, 5, VanType::Seated));
+        REQUIRE(train.TryAt(0)->TryAddPassengers(2).error() == VanError::OverCapacity);
+        REQUIRE(train.TryAt(0)->TryAddPassengers(1));
+        REQUIRE(train.TryAt(0)->TryTransfer(train.UncheckedAt(1)));
+        REQUIRE(train.StaffingPercentage().TotalOccupied() == 15);
+        REQUIRE(train.UncheckedAt(1).TrySetCapacity(1).error() == VanError::OverNewCapacity);
+        REQUIRE(std::as_const(train).UncheckedAt(1) == train[1]);
+        REQUIRE_THROWS_AS(train[2], std::out_of_range);
+    }
+
+    SECTION("Structural changes report bad positions") {
+        Train train;
+        train += Van(10, 3, VanType::Economy);
+        train += Van(20, 5, VanType::Seated);
+        std::vector<Van> section{Van(30, 1, VanType::Luxury)};
+        REQUIRE(train.TryRemoveVan(2).error() == VanError::IndexOutOfRange);
+        REQUIRE(train.TryEraseRange(1, 3).error() == VanError::IndexOutOfRange);
+        REQUIRE(train.TryEraseRange(2, 1).error() == VanError::IndexOutOfRange);
+        REQUIRE(train.TryInsertAt(3, section).error() == VanError::IndexOutOfRange);
+        REQUIRE(train.GetSize() == 2);
+        REQUIRE(train.TryInsertAt(2, section));
+        REQUIRE(train.TryEraseRange(0, 1));
+        REQUIRE(train.TryRemoveVan(0));
+        REQUIRE(train.GetSize() == 1);
+        REQUIRE(train[0] == Van(30, 1, VanType::Luxury));
+        REQUIRE_THROWS_AS(train.RemoveVan(1), std::out_of_range);
+    }
+}
+
+static_assert(std::random_access_iterator<Train::Iterator>);
+static_assert(std::random_access_iterator<Train::ConstIterator>);
+static_assert(std::ranges::random_access_range<const Train>);
+static_assert(std::ranges::sized_range<Train>);
+static_assert(std::ranges::contiguous_range<decltype(std::declval<const Train&>().OccupiedSeats())>);
+
+TEST_CASE("Train iteration") {
+    Train train;
+    for (size_t i = 0; i < 40; ++i)
+        train += Van(10 + i, i % 7, VanType::Economy);
+    const Train& view = train;
+
+    size_t index = 0;
+    for (Van van : view)
+        REQUIRE(van == view[index++]);
+    REQUIRE(index == train.GetSize());
+    REQUIRE(std::ranges::distance(view) == 40);
+    REQUIRE(view.end() - view.begin() == 40);
+    REQUIRE(view.begin()[5] == view[5]);
+    REQUIRE(*(view.end() - 1) == view[39]);
+    Train::ConstIterator first = train.begin();
+    REQUIRE(first == view.cbegin());
+    REQUIRE(first < view.cend());
+
+    auto full = std::ranges::find_if(view, [](const Van& van) { return van.GetOccupiedSeats() == 6; });
+    REQUIRE(full - view.begin() == 6);
+    size_t seats = std::reduce(view.OccupiedSeats().begin(), view.OccupiedSeats().end(), size_t{0});
+    REQUIRE(seats == train.StaffingPercentage().TotalOccupied());
+
+    // Mutable iterators hand out VanRefs, which keep the totals in step.
+    for (Train::VanRef van : train)
+        van.AddPassengers(1);
+    REQUIRE(train.StaffingPercentage().TotalOccupied() == seats + 40);
+    Train copy;
+    copy.Append(view);
+    REQUIRE(copy == train);
+}
+
+TEST_CASE("Bulk erase and insert") {
+    std::mt19937_64 gen(31);
+    auto randomVan = [&] {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        return Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    };
+    std::vector<Van> model;
+    Train train, indexed;
+    indexed.EnableSeatIndex();
+    indexed.EnablePlacementIndex();
+    for (size_t i = 0; i < 200; ++i) {
+        model.push_back(randomVan());
+        train += model.back();
+        indexed += model.back();
+    }
+
+    for (size_t round = 0; round < 40; ++round) {
+        if (round % 3 == 0) {
+            size_t first = gen() % (model.size() + 1), last = first + gen() % (model.size() - first + 1);
+            model.erase(model.begin() + static_cast<std::ptrdiff_t>(first), model.begin() + static_cast<std::ptrdiff_t>(last));
+            train.EraseRange(first, last);
+            indexed.EraseRange(first, last);
+        } else if (round % 3 == 1) {
+            std::vector<Van> section;
+            for (size_t i = gen() % 60; i > 0; --i)
+                section.push_back(randomVan());
+            size_t pos = gen() % (model.size() + 1);
+            model.insert(model.begin() + static_cast<std::ptrdiff_t>(pos), section.begin(), section.end());
+            train.InsertAt(pos, section);
+            indexed.InsertAt(pos, section);
+        } else {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            auto match = [type](const Van& van) { return van.GetType() == type && van.GetOccupiedSeats() % 2 == 0; };
+            size_t expected = static_cast<size_t>(std::erase_if(model, match));
+            REQUIRE(train.EraseIf(match) == expected);
+            REQUIRE(indexed.EraseIf(match) == expected);
+        }
+        REQUIRE(train == Train(model.data(), model.size()));
+        REQUIRE(indexed == train);
+        Train fresh(model.data(), model.size());
+        for (size_t t = 0; t < VanTypeCount; ++t) {
+            REQUIRE(train.StaffingPercentage().types[t].occupied == fresh.StaffingPercentage().types[t].occupied);
+            REQUIRE(indexed.StaffingPercentage().types[t].vans == fresh.StaffingPercentage().types[t].vans);
+        }
+        REQUIRE(indexed.FindBestFit(3) == fresh.FindBestFit(3));
+    }
+    Train placed = train;
+    train.PlaceRestaurantVanOptimally();
+    indexed.PlaceRestaurantVanOptimally();
+    REQUIRE(indexed == train);
+
+    // A decoupled section goes back in front of the same van, and storage follows the size.
+    Train consist;
+    for (size_t i = 0; i < 200; ++i)
+        consist += Van(50, i % 50, VanType::Economy);
+    Train original = consist;
+    std::vector<Van> section(consist.begin() + 40, consist.begin() + 160);
+    consist.EraseRange(40, 160);
+    REQUIRE(consist.GetSize() == 80);
+    consist.InsertAt(40, section);
+    REQUIRE(consist == original);
+    consist.EraseRange(0, 190);
+    REQUIRE(consist.GetStorageCapacity() == 2 * consist.GetSize());
+    REQUIRE_THROWS_AS(consist.EraseRange(5, 11), std::out_of_range);
+    REQUIRE_THROWS_AS(consist.InsertAt(11, section), std::out_of_range);
+    consist.InsertAt(consist.GetSize(), placed);
+    REQUIRE(consist.GetSize() == 10 + placed.GetSize());
+
+    // A throwing predicate leaves a consistent train: vans it picked before are gone.
+    Train partial = original;
+    size_t seen = 0;
+    REQUIRE_THROWS_AS(partial.EraseIf([&seen](const Van& van) {
+        if (++seen == 100)
+            throw std::runtime_error("predicate failed");
+        return van.GetOccupiedSeats() % 2 == 0;
+    }), std::runtime_error);
+    REQUIRE(partial.GetSize() == 150);
+    std::vector<Van> expected;
+    for (size_t i = 0; i < original.GetSize(); ++i) {
+        if (i >= 99 || original[i].GetOccupiedSeats() % 2 != 0)
+            expected.push_back(original[i]);
+    }
+    Train rebuilt(expected.data(), expected.size());
+    REQUIRE(partial == rebuilt);
+    REQUIRE(partial.GetContentHash() == rebuilt.GetContentHash());
+    REQUIRE(partial.StaffingPercentage().TotalOccupied() == rebuilt.StaffingPercentage().TotalOccupied());
+}
+
+TEST_CASE("Content hash") {
+    std::mt19937_64 gen(37);
+    auto randomVan = [&] {
+        VanType type = static_cast<VanType>(gen() % VanTypeCount);
+        size_t capacity = DefaultCapacityOf(type);
+        return Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+    };
+    Train train;
+    train.EnableSeatIndex();
+    REQUIRE(train.GetContentHash() == Train().GetContentHash());
+    for (size_t i = 0; i < 300; ++i)
+        train += randomVan();
+
+    // Every mutation keeps the running hash equal to that of a train built from scratch.
+    auto fresh = [](const Train& t) {
+        std::vector<Van> vans(t.begin(), t.end());
+        return Train(vans.data(), vans.size()).GetContentHash();
+    };
+    for (size_t round = 0; round < 60; ++round) {
+        switch (round % 10) {
+        case 0: train += randomVan(); break;
+        case 1: train.RemoveVan(gen() % train.GetSize()); break;
+        case 2: train.SitInMin(1 + gen() % 4); break;
+        case 3: { std::vector<size_t> groups(20, 2); train.SitInMinBatch(groups); break; }
+        case 4: train[gen() % train.GetSize()].RemovePassengers(3); break;
+        case 5: train[gen() % train.GetSize()] = randomVan(); break;
+        case 6: train.PlaceRestaurantVanOptimally(); train.PlaceRestaurantVansOptimally(); break;
+        case 7: train.BalanceOccupancy(); break;
+        case 8: train.EraseIf([](const Van& van) { return van.GetOccupiedSeats() == 7; }); break;
+        default: { std::vector<Van> section{randomVan(), randomVan()}; train.InsertAt(gen() % train.GetSize(), section); }
+        }
+        REQUIRE(train.GetContentHash() == fresh(train));
+    }
+    train.MinimizeVans();
+    REQUIRE(train.GetContentHash() == fresh(train));
+
+    // Two known, different vans up front so every change below is a real change.
+    Train base = train;
+    base[0] = Van(78, 10, VanType::Seated);
+    base[1] = Van(56, 20, VanType::Economy);
+    REQUIRE(base.GetContentHash() == fresh(base));
+    Train copy = base;
+    REQUIRE(std::hash<Train>{}(copy) == std::hash<Train>{}(base));
+    copy[0].RemovePassengers(1000);
+    copy[1].RemovePassengers(1000);
+    REQUIRE(copy != base);
+    REQUIRE(copy.GetContentHash() != base.GetContentHash());
+    Train swapped = base;
+    swapped[0] = base[1];
+    swapped[1] = base[0];
+    REQUIRE(swapped != base);
+    REQUIRE(swapped.GetContentHash() != base.GetContentHash());
+    std::unordered_set<Train> seen{base, copy, base};
+    REQUIRE(seen.size() == 2);
+}
+
+TEST_CASE("Optimizer cache") {
+    std::mt19937_64 gen(41);
+    std::vector<Train> trains(3);
+    for (Train& train : trains) {
+        for (size_t i = 0; i < 200; ++i) {
+            VanType type = static_cast<VanType>(gen() % VanTypeCount);
+            size_t capacity = DefaultCapacityOf(type);
+            train += Van(capacity, capacity ? gen() % (capacity + 1) : 0, type);
+        }
+    }
+    REQUIRE_THROWS_AS(OptimizerCache(0), std::invalid_argument);
+    OptimizerCache cache(2);
+
+    auto check = [&](size_t t, auto pass, auto reference) {
+        Train cached = trains[t], expected = trains[t];
+        cached.EnablePlacementIndex();
+        (cache.*pass)(cached);
+        (expected.*reference)();
+        REQUIRE(cached == expected);
+        REQUIRE(cached.HasPlacementIndex());
+        REQUIRE_FALSE(cached.HasSeatIndex());
+        REQUIRE(cached.GetContentHash() == expected.GetContentHash());
+    };
+    using Run = void (Train::*)();
+    Run balance = &Train::BalanceOccupancy, minimize = &Train::MinimizeVans, place = &Train::PlaceRestaurantVanOptimally;
+
+    check(0, &OptimizerCache::BalanceOccupancy, balance);
+    check(0, &OptimizerCache::BalanceOccupancy, balance);
+    REQUIRE(cache.GetHits() == 1);
+    REQUIRE(cache.GetMisses() == 1);
+    check(0, &OptimizerCache::MinimizeVans, minimize);
+    REQUIRE(cache.GetMisses() == 2);
+    check(1, &OptimizerCache::PlaceRestaurantVanOptimally, place);
+    REQUIRE(cache.GetSize() == 2);
+    // The balance result for train 0 was the least recently used and is gone.
+    check(0, &OptimizerCache::BalanceOccupancy, balance);
+    REQUIRE(cache.GetMisses() == 4);
+    check(1, &OptimizerCache::PlaceRestaurantVanOptimally, place);
+    REQUIRE(cache.GetHits() == 2);
+    // A mutated train no longer matches its old entry.
+    trains[1][5].RemovePassengers(1000);
+    check(1, &OptimizerCache::PlaceRestaurantVanOptimally, place);
+    REQUIRE(cache.GetHits() == 2);
+    cache.Clear();
+    REQUIRE(cache.GetSize() == 0);
+    REQUIRE(cache.GetMisses() == 0);
+}
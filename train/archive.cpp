@@ -0,0 +1,293 @@
+#include "archive.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace mgt {
+
+namespace {
+
+constexpr char ArchiveMagic[8] = {'M', 'G', 'T', 'A', 'R', 'C', 'H', '\0'};
+constexpr uint32_t ArchiveVersion = 2;
+
+static_assert(VanTypeCount <= 256, "type runs store the van type in one byte");
+
+class ByteWriter {
+public:
+    explicit ByteWriter(std::vector<uint8_t>& out) noexcept : out_(out) {}
+
+    void Bytes(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), bytes, bytes + length);
+    }
+
+    template <typename T>
+    void Put(T value) {
+        for (size_t i = 0; i < sizeof(T); ++i)
+            out_.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+};
+
+class ByteReader {
+public:
+    ByteReader(std::span<const uint8_t> data, size_t pos) noexcept : data_(data), pos_(pos) {}
+
+    const uint8_t* Skip(size_t length) {
+        if (length > data_.size() - pos_)
+            throw std::invalid_argument("Error: Archive ends inside a block.");
+        const uint8_t* bytes = data_.data() + pos_;
+        pos_ += length;
+        return bytes;
+    }
+
+    template <typename T>
+    T Get() {
+        const uint8_t* bytes = Skip(sizeof(T));
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        return static_cast<T>(value);
+    }
+
+    size_t Position() const noexcept { return pos_; }
+
+private:
+    std::span<const uint8_t> data_;
+    size_t pos_;
+};
+
+uint64_t LoadWord(const uint8_t* bytes) noexcept {
+    uint64_t word = 0;
+    for (size_t i = 0; i < 8; ++i)
+        word |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    return word;
+}
+
+constexpr size_t PackedWords(size_t count, unsigned width) noexcept { return (count * width + 63) / 64; }
+
+uint64_t ZigZag(size_t current, size_t previous) noexcept {
+    uint64_t delta = current - previous;
+    return (delta << 1) ^ static_cast<uint64_t>(-static_cast<int64_t>(delta >> 63));
+}
+
+// The delta to add to the previous value, wrapping like ZigZag's subtraction.
+uint64_t UnZigZag(uint64_t code) noexcept {
+    return (code >> 1) ^ static_cast<uint64_t>(-static_cast<int64_t>(code & 1));
+}
+
+void EncodeBlock(ByteWriter& out, const size_t* capacities, const size_t* occupied, const VanType* types, size_t count) {
+    OccupancyStats stats = SumOccupancy(capacities, occupied, types, count);
+    out.Put<uint16_t>(static_cast<uint16_t>(count));
+    out.Put<uint16_t>(static_cast<uint16_t>(stats.seatingVans));
+    for (const TypeStats& stat : stats.types) {
+        out.Put<uint16_t>(static_cast<uint16_t>(stat.vans));
+        out.Put<uint64_t>(stat.capacity);
+        out.Put<uint64_t>(stat.occupied);
+    }
+
+    size_t runs = 1;
+    for (size_t i = 1; i < count; ++i)
+        runs += types[i] != types[i - 1];
+    out.Put<uint16_t>(static_cast<uint16_t>(runs));
+    for (size_t i = 0; i < count;) {
+        size_t end = i + 1;
+        while (end < count && types[end] == types[i])
+            ++end;
+        out.Put<uint8_t>(static_cast<uint8_t>(types[i]));
+        out.Put<uint16_t>(static_cast<uint16_t>(end - i));
+        i = end;
+    }
+
+    uint8_t bitmap[ArchiveBlockVans / 8] = {};
+    size_t exceptions = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (capacities[i] == DefaultCapacityOf(types[i]))
+            bitmap[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        else
+            ++exceptions;
+    }
+    out.Bytes(bitmap, (count + 7) / 8);
+    out.Put<uint16_t>(static_cast<uint16_t>(exceptions));
+    for (size_t i = 0; i < count; ++i) {
+        if (!(bitmap[i / 8] >> (i % 8) & 1))
+            out.Put<uint64_t>(capacities[i]);
+    }
+
+    uint64_t codes[ArchiveBlockVans], widest = 0;
+    for (size_t i = 1; i < count; ++i) {
+        codes[i - 1] = ZigZag(occupied[i], occupied[i - 1]);
+        widest |= codes[i - 1];
+    }
+    unsigned width = static_cast<unsigned>(std::bit_width(widest));
+    out.Put<uint64_t>(occupied[0]);
+    out.Put<uint8_t>(static_cast<uint8_t>(width));
+    uint64_t words[ArchiveBlockVans] = {};
+    for (size_t i = 0; i + 1 < count && width > 0; ++i) {
+        size_t bit = i * width;
+        words[bit / 64] |= codes[i] << (bit % 64);
+        if (bit % 64 + width > 64)
+            words[bit / 64 + 1] |= codes[i] >> (64 - bit % 64);
+    }
+    for (size_t w = 0; w < PackedWords(count - 1, width); ++w)
+        out.Put<uint64_t>(words[w]);
+}
+
+} // namespace
+
+void EncodeArchive(std::span<const Train* const> trains, std::vector<uint8_t>& out) {
+    ByteWriter writer(out);
+    writer.Bytes(ArchiveMagic, sizeof(ArchiveMagic));
+    writer.Put<uint32_t>(ArchiveVersion);
+    writer.Put<uint32_t>(static_cast<uint32_t>(VanTypeCount));
+    writer.Put<uint32_t>(static_cast<uint32_t>(trains.size()));
+    for (const Train* train : trains) {
+        size_t size = train->GetSize();
+        writer.Put<uint64_t>(size);
+        std::span<const size_t> capacities = train->Capacities(), occupied = train->OccupiedSeats();
+        std::span<const VanType> types = train->Types();
+        for (size_t first = 0; first < size; first += ArchiveBlockVans) {
+            size_t count = std::min(ArchiveBlockVans, size - first);
+            EncodeBlock(writer, capacities.data() + first, occupied.data() + first, types.data() + first, count);
+        }
+    }
+}
+
+ArchiveReader::ArchiveReader(std::span<const uint8_t> data) : data_(data) {
+    ByteReader reader(data, 0);
+    if (std::memcmp(reader.Skip(sizeof(ArchiveMagic)), ArchiveMagic, sizeof(ArchiveMagic)) != 0)
+        throw std::invalid_argument("Error: Not a train archive.");
+    if (reader.Get<uint32_t>() != ArchiveVersion)
+        throw std::invalid_argument("Error: Unsupported archive version.");
+    if (reader.Get<uint32_t>() != VanTypeCount)
+        throw std::invalid_argument("Error: Archive was written with a different set of van types.");
+    uint32_t trainCount = reader.Get<uint32_t>();
+    for (uint32_t t = 0; t < trainCount; ++t) {
+        TrainEntry entry{reader.Get<uint64_t>(), blocks_.size(), 0};
+        // Walk the blocks once so any block can later be decoded directly.
+        for (size_t vans = 0; vans < entry.vans; ++entry.blockCount) {
+            blocks_.push_back(reader.Position());
+            size_t count = reader.Get<uint16_t>();
+            if (count == 0 || count > ArchiveBlockVans || count > entry.vans - vans)
+                throw std::invalid_argument("Error: Archive block has a bad van count.");
+            reader.Skip(2 + VanTypeCount * 18);
+            reader.Skip(3 * size_t{reader.Get<uint16_t>()});
+            reader.Skip((count + 7) / 8);
+            reader.Skip(8 * size_t{reader.Get<uint16_t>()});
+            reader.Skip(8);
+            unsigned width = reader.Get<uint8_t>();
+            if (width > 64)
+                throw std::invalid_argument("Error: Archive block has a bad bit width.");
+            reader.Skip(8 * PackedWords(count - 1, width));
+            vans += count;
+        }
+        trains_.push_back(entry);
+    }
+}
+
+size_t ArchivedTrain::GetSize() const noexcept { return reader_->trains_[train_].vans; }
+
+size_t ArchivedTrain::GetBlockCount() const noexcept { return reader_->trains_[train_].blockCount; }
+
+OccupancyStats ArchivedTrain::BlockStats(size_t block) const {
+    if (block >= GetBlockCount())
+        throw std::out_of_range("Index out of train blocks");
+    ByteReader reader(reader_->data_, reader_->blocks_[reader_->trains_[train_].firstBlock + block] + 2);
+    OccupancyStats stats;
+    stats.seatingVans = reader.Get<uint16_t>();
+    for (TypeStats& stat : stats.types) {
+        stat.vans = reader.Get<uint16_t>();
+        stat.capacity = reader.Get<uint64_t>();
+        stat.occupied = reader.Get<uint64_t>();
+    }
+    return stats;
+}
+
+OccupancyStats ArchivedTrain::StaffingPercentage() const {
+    OccupancyStats total;
+    for (size_t b = 0; b < GetBlockCount(); ++b) {
+        OccupancyStats block = BlockStats(b);
+        total.seatingVans += block.seatingVans;
+        for (size_t t = 0; t < VanTypeCount; ++t) {
+            total.types[t].vans += block.types[t].vans;
+            total.types[t].capacity += block.types[t].capacity;
+            total.types[t].occupied += block.types[t].occupied;
+        }
+    }
+    return total;
+}
+
+size_t ArchivedTrain::DecodeBlock(size_t block, size_t* capacities, size_t* occupied, VanType* types) const {
+    if (block >= GetBlockCount())
+        throw std::out_of_range("Index out of train blocks");
+    ByteReader reader(reader_->data_, reader_->blocks_[reader_->trains_[train_].firstBlock + block]);
+    size_t count = reader.Get<uint16_t>();
+    reader.Skip(2 + VanTypeCount * 18);
+
+    size_t runs = reader.Get<uint16_t>(), filled = 0;
+    for (size_t r = 0; r < runs; ++r) {
+        size_t type = reader.Get<uint8_t>(), length = reader.Get<uint16_t>();
+        if (type >= VanTypeCount || length > count - filled)
+            throw std::invalid_argument("Error: Archive block has a bad type run.");
+        std::fill_n(types + filled, length, static_cast<VanType>(type));
+        filled += length;
+    }
+    if (filled != count)
+        throw std::invalid_argument("Error: Archive block type runs do not cover the block.");
+
+    const uint8_t* bitmap = reader.Skip((count + 7) / 8);
+    size_t exceptions = reader.Get<uint16_t>();
+    const uint8_t* values = reader.Skip(8 * exceptions);
+    size_t used = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (bitmap[i / 8] >> (i % 8) & 1) {
+            capacities[i] = DefaultCapacityOf(types[i]);
+        } else {
+            if (used == exceptions)
+                throw std::invalid_argument("Error: Archive block is missing capacities.");
+            capacities[i] = LoadWord(values + 8 * used++);
+        }
+    }
+
+    occupied[0] = reader.Get<uint64_t>();
+    unsigned width = reader.Get<uint8_t>();
+    size_t wordCount = PackedWords(count - 1, width);
+    const uint8_t* packed = reader.Skip(8 * wordCount);
+
+    // Three straight-line passes the compiler can vectorize: load the words (plus a zero
+    // word so every delta can read the word after its own), unpack every delta without
+    // branching, then a prefix sum.
+    uint64_t words[PackedWords(ArchiveBlockVans - 1, 64) + 1];
+    for (size_t w = 0; w < wordCount; ++w)
+        words[w] = LoadWord(packed + 8 * w);
+    words[wordCount] = 0;
+    uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    uint64_t deltas[ArchiveBlockVans];
+    for (size_t i = 0; i + 1 < count; ++i) {
+        size_t bit = i * width, word = bit / 64, shift = bit % 64;
+        // Shifting by 1 and then 63 - shift yields 0 rather than UB when shift is 0.
+        uint64_t code = (words[word] >> shift | (words[word + 1] << 1) << (63 - shift)) & mask;
+        deltas[i] = UnZigZag(code);
+    }
+    for (size_t i = 1; i < count; ++i)
+        occupied[i] = occupied[i - 1] + deltas[i - 1];
+    return count;
+}
+
+Train ArchivedTrain::Decode() const {
+    Train train;
+    train.Reserve(GetSize());
+    size_t capacities[ArchiveBlockVans], occupied[ArchiveBlockVans];
+    VanType types[ArchiveBlockVans];
+    for (size_t b = 0; b < GetBlockCount(); ++b) {
+        size_t count = DecodeBlock(b, capacities, occupied, types);
+        for (size_t i = 0; i < count; ++i)
+            train += Van(capacities[i], occupied[i], types[i]);
+    }
+    return train;
+}
+
+} // namespace mgt
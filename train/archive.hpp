@@ -0,0 +1,86 @@
+#ifndef ARCHIVE_HPP_
+#define ARCHIVE_HPP_
+
+#include "../van/van.hpp"
+#include "occupancy_stats.hpp"
+#include "train.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace mgt {
+
+// Compressed columnar encoding of trains for long-term storage. The header records
+// VanTypeCount, which sizes the block totals. Each train is cut into blocks of
+// ArchiveBlockVans vans, and every block stores, little-endian:
+//
+//   van count and the block's per-type van/capacity/occupancy totals
+//   type column      run-length encoded as (type, length) pairs
+//   capacity column  a bitmap of vans at DefaultCapacityOf(type), then the other values
+//   occupancy column the first value, then zigzag deltas bit-packed at the block's width
+//
+// Aggregates are answered from the block totals without decoding any column.
+inline constexpr size_t ArchiveBlockVans = 1024;
+
+// Appends an archive holding `trains` to `out`.
+void EncodeArchive(std::span<const Train* const> trains, std::vector<uint8_t>& out);
+
+class ArchiveReader;
+
+// One train inside an archive. Valid as long as the reader and its bytes.
+class ArchivedTrain {
+private:
+    const ArchiveReader* reader_;
+    size_t train_;
+
+    friend class ArchiveReader;
+    ArchivedTrain(const ArchiveReader* reader, size_t train) noexcept : reader_(reader), train_(train) {}
+
+public:
+    size_t GetSize() const noexcept;
+    size_t GetBlockCount() const noexcept;
+
+    // Totals of one block, or of the whole train, straight from the block headers.
+    [[nodiscard]] OccupancyStats BlockStats(size_t block) const;
+    [[nodiscard]] OccupancyStats StaffingPercentage() const;
+
+    // Decodes one block into columns with room for ArchiveBlockVans values each and
+    // returns the number of vans written.
+    size_t DecodeBlock(size_t block, size_t* capacities, size_t* occupied, VanType* types) const;
+
+    // Decodes every block into a Train.
+    [[nodiscard]] Train Decode() const;
+};
+
+// Indexes the blocks of an archive held in memory; the bytes are not copied and must
+// outlive the reader. Throws std::invalid_argument if the archive is malformed.
+class ArchiveReader {
+private:
+    struct TrainEntry {
+        size_t vans;
+        size_t firstBlock;
+        size_t blockCount;
+    };
+
+    std::span<const uint8_t> data_;
+    std::vector<TrainEntry> trains_;
+    std::vector<size_t> blocks_; // byte offset of every block, train after train
+
+    friend class ArchivedTrain;
+
+public:
+    explicit ArchiveReader(std::span<const uint8_t> data);
+
+    size_t GetTrainCount() const noexcept { return trains_.size(); }
+
+    ArchivedTrain operator[](size_t index) const {
+        if (index >= trains_.size())
+            throw std::out_of_range("Index out of archive range");
+        return ArchivedTrain(this, index);
+    }
+};
+
+} // namespace mgt
+
+#endif
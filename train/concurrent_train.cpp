@@ -0,0 +1,210 @@
+#include "concurrent_train.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace mgt {
+
+namespace {
+
+// Threads are spread over the reader stripes round-robin in the order they first book.
+size_t ThreadStripe(size_t stripes) noexcept {
+    static std::atomic<size_t> next{0};
+    thread_local size_t stripe = next.fetch_add(1, std::memory_order_relaxed);
+    return stripe % stripes;
+}
+
+} // namespace
+
+// The increment has to be visible before the epoch is checked again, and the epoch before
+// the table is loaded, so these stay sequentially consistent. Occupancy cells are
+// independent counters and use relaxed operations throughout.
+ConcurrentTrain::ReadGuard::ReadGuard(const ConcurrentTrain& train) noexcept {
+    ReaderCount& stripe = train.readers_[ThreadStripe(ReaderStripes)];
+    while (true) {
+        size_t epoch = train.epoch_.load();
+        count_ = &stripe.count[epoch & 1];
+        count_->fetch_add(1);
+        if (train.epoch_.load() == epoch)
+            break;
+        count_->fetch_sub(1);
+    }
+    consist_ = train.current_.load();
+}
+
+ConcurrentTrain::ReadGuard::~ReadGuard() { count_->fetch_sub(1); }
+
+ConcurrentTrain::ConcurrentTrain() : current_(new Consist(Train::InlineVans)) {}
+
+ConcurrentTrain::ConcurrentTrain(const Train& train) : current_(nullptr) {
+    auto consist = std::make_unique<Consist>(std::max(train.GetSize(), Train::InlineVans));
+    for (size_t i = 0; i < train.GetSize(); ++i)
+        consist->slots[i] = {train.Capacities()[i], NewCell(train.OccupiedSeats()[i]), train.Types()[i]};
+    consist->size.store(train.GetSize(), std::memory_order_relaxed);
+    current_.store(consist.release());
+}
+
+ConcurrentTrain::~ConcurrentTrain() { delete current_.load(); }
+
+size_t ConcurrentTrain::SitInMin(size_t numOfPassengers) {
+    ReadGuard guard(*this);
+    const Consist& consist = guard.Get();
+    while (true) {
+        size_t size = consist.size.load(std::memory_order_acquire);
+        size_t best = NotSeated, bestOccupied = 0;
+        for (size_t i = 0; i < size; ++i) {
+            const Slot& slot = consist.slots[i];
+            size_t occupied = slot.occupied->load(std::memory_order_relaxed);
+            if (slot.capacity - occupied >= numOfPassengers && (best == NotSeated || occupied < bestOccupied)) {
+                best = i;
+                bestOccupied = occupied;
+            }
+        }
+        if (best == NotSeated)
+            return NotSeated;
+        // Another booking got to the van first: look again, it may no longer be the best fit.
+        if (consist.slots[best].occupied->compare_exchange_weak(bestOccupied, bestOccupied + numOfPassengers,
+                                                                std::memory_order_relaxed))
+            return best;
+    }
+}
+
+void ConcurrentTrain::AddPassengers(size_t index, size_t count) {
+    ReadGuard guard(*this);
+    const Consist& consist = guard.Get();
+    if (index >= consist.size.load(std::memory_order_acquire))
+        throw std::out_of_range("Index out of train range");
+    const Slot& slot = consist.slots[index];
+    size_t occupied = slot.occupied->load(std::memory_order_relaxed);
+    do {
+        if (count > slot.capacity - occupied)
+            throw std::invalid_argument("Error: Occupied seats exceed capacity.");
+    } while (!slot.occupied->compare_exchange_weak(occupied, occupied + count, std::memory_order_relaxed));
+}
+
+void ConcurrentTrain::RemovePassengers(size_t index, size_t count) {
+    ReadGuard guard(*this);
+    const Consist& consist = guard.Get();
+    if (index >= consist.size.load(std::memory_order_acquire))
+        throw std::out_of_range("Index out of train range");
+    std::atomic<size_t>& cell = *consist.slots[index].occupied;
+    size_t occupied = cell.load(std::memory_order_relaxed);
+    while (!cell.compare_exchange_weak(occupied, occupied < count ? 0 : occupied - count, std::memory_order_relaxed)) {}
+}
+
+size_t ConcurrentTrain::GetSize() const noexcept {
+    ReadGuard guard(*this);
+    return guard.Get().size.load(std::memory_order_acquire);
+}
+
+Van ConcurrentTrain::operator[](size_t index) const {
+    ReadGuard guard(*this);
+    const Consist& consist = guard.Get();
+    if (index >= consist.size.load(std::memory_order_acquire))
+        throw std::out_of_range("Index out of train range");
+    const Slot& slot = consist.slots[index];
+    return Van(slot.capacity, slot.occupied->load(std::memory_order_relaxed), slot.type);
+}
+
+OccupancyStats ConcurrentTrain::StaffingPercentage() const {
+    ReadGuard guard(*this);
+    const Consist& consist = guard.Get();
+    OccupancyStats stats;
+    for (size_t i = 0, size = consist.size.load(std::memory_order_acquire); i < size; ++i) {
+        const Slot& slot = consist.slots[i];
+        TypeStats& stat = stats.types[static_cast<size_t>(slot.type)];
+        ++stat.vans;
+        stat.capacity += slot.capacity;
+        stat.occupied += slot.occupied->load(std::memory_order_relaxed);
+        stats.seatingVans += slot.capacity > 0;
+    }
+    return stats;
+}
+
+Train ConcurrentTrain::ToTrain() const {
+    ReadGuard guard(*this);
+    const Consist& consist = guard.Get();
+    size_t size = consist.size.load(std::memory_order_acquire);
+    Train train;
+    train.Reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        const Slot& slot = consist.slots[i];
+        train += Van(slot.capacity, slot.occupied->load(std::memory_order_relaxed), slot.type);
+    }
+    return train;
+}
+
+ConcurrentTrain& ConcurrentTrain::operator+=(const Van& van) {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    Consist* consist = current_.load();
+    size_t size = consist->size.load(std::memory_order_relaxed);
+    std::unique_ptr<Consist> grown;
+    if (size == consist->capacity) {
+        grown = std::make_unique<Consist>(consist->capacity * 2);
+        std::copy_n(consist->slots.get(), size, grown->slots.get());
+        grown->size.store(size, std::memory_order_relaxed);
+    }
+    Consist& target = grown ? *grown : *consist;
+    // Bookers only read slots below the published size, so the new slot can be filled in place.
+    target.slots[size] = {van.GetCapacity(), NewCell(van.GetOccupiedSeats()), van.GetType()};
+    target.size.store(size + 1, std::memory_order_release);
+    if (grown)
+        Publish(grown.release());
+    return *this;
+}
+
+void ConcurrentTrain::RemoveVan(size_t index) {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    Consist* consist = current_.load();
+    size_t size = consist->size.load(std::memory_order_relaxed);
+    if (index >= size)
+        throw std::out_of_range("Index out of train range");
+    // Same hysteresis as Train: halve the table only once it is down to a quarter.
+    size_t storage = consist->capacity > Train::InlineVans && size - 1 <= consist->capacity / 4
+        ? consist->capacity / 2 : consist->capacity;
+    auto next = std::make_unique<Consist>(storage);
+    std::copy_n(consist->slots.get(), size - 1, next->slots.get());
+    if (index != size - 1)
+        next->slots[index] = consist->slots[size - 1];
+    next->size.store(size - 1, std::memory_order_relaxed);
+    std::atomic<size_t>* removed = consist->slots[index].occupied;
+    freeCells_.reserve(freeCells_.size() + 1);
+    Publish(next.release());
+    // No booking can reach the removed van's cell any more, so it can be handed out again.
+    freeCells_.push_back(removed);
+}
+
+std::atomic<size_t>* ConcurrentTrain::NewCell(size_t occupied) {
+    std::atomic<size_t>* cell;
+    if (!freeCells_.empty()) {
+        cell = freeCells_.back();
+        freeCells_.pop_back();
+    } else {
+        if (chunkUsed_ == CellChunk) {
+            cellChunks_.push_back(std::make_unique<std::atomic<size_t>[]>(CellChunk));
+            chunkUsed_ = 0;
+        }
+        cell = &cellChunks_.back()[chunkUsed_++];
+    }
+    cell->store(occupied, std::memory_order_relaxed);
+    return cell;
+}
+
+void ConcurrentTrain::Publish(Consist* next) {
+    Consist* previous = current_.exchange(next);
+    Synchronize();
+    delete previous;
+}
+
+// Waits until every booking that entered before the flip, and so may still hold the
+// previous table, has left. Bookings entering after it see the new table.
+void ConcurrentTrain::Synchronize() noexcept {
+    size_t epoch = epoch_.load();
+    epoch_.store(epoch + 1);
+    for (ReaderCount& stripe : readers_) {
+        while (stripe.count[epoch & 1].load() != 0)
+            std::this_thread::yield();
+    }
+}
+
+} // namespace mgt
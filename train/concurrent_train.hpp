@@ -0,0 +1,107 @@
+#ifndef CONCURRENT_TRAIN_HPP_
+#define CONCURRENT_TRAIN_HPP_
+
+#include "../van/van.hpp"
+#include "occupancy_stats.hpp"
+#include "train.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mgt {
+
+// A train that many threads can book seats on at once. Each van's occupancy is an atomic
+// counter updated by compare-and-swap, so bookings never take a lock and never push a van
+// past its capacity. Structural changes (+=, RemoveVan) are serialized among themselves and
+// publish a new van table read-copy-update style: bookers keep using the table they started
+// with, and the old one is freed once every booking that could still see it has finished.
+class ConcurrentTrain {
+public:
+    static constexpr size_t NotSeated = Train::NotSeated;
+
+    ConcurrentTrain();
+    explicit ConcurrentTrain(const Train& train);
+    ConcurrentTrain(const ConcurrentTrain&) = delete;
+    ConcurrentTrain& operator=(const ConcurrentTrain&) = delete;
+    ~ConcurrentTrain();
+
+    // Safe to call from any number of threads, concurrently with each other and with the
+    // structural changes below. Indexes follow Train: RemoveVan moves the last van into the
+    // removed slot, so an index returned by SitInMin may name another van after a removal.
+    size_t SitInMin(size_t numOfPassengers);
+    void AddPassengers(size_t index, size_t count);
+    void RemovePassengers(size_t index, size_t count);
+
+    [[nodiscard]] size_t GetSize() const noexcept;
+    Van operator[](size_t index) const;
+
+    // Every van's occupancy is read once, but bookings running at the same time may land
+    // between those reads, so the result is not a single instant across vans.
+    [[nodiscard]] OccupancyStats StaffingPercentage() const;
+    [[nodiscard]] Train ToTrain() const;
+
+    ConcurrentTrain& operator+=(const Van& van);
+    void RemoveVan(size_t index);
+
+private:
+    // Occupancy cells are shared by every table that contains the van, so a booking made
+    // through an old table is never lost when a new one is published.
+    struct Slot {
+        size_t capacity;
+        std::atomic<size_t>* occupied;
+        VanType type;
+    };
+
+    struct Consist {
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity;
+        std::atomic<size_t> size; // += fills slots[size] and then publishes it here
+
+        explicit Consist(size_t storage) : slots(new Slot[storage]), capacity(storage), size(0) {}
+    };
+
+    // Bookers announce themselves on one of these counters, chosen per thread, under the
+    // parity of the epoch they entered in; a writer flips the epoch and waits for the old
+    // parity to drain. Striping keeps bookers on different cores off one cache line.
+    static constexpr size_t ReaderStripes = 32;
+
+    struct alignas(64) ReaderCount {
+        std::atomic<size_t> count[2] = {0, 0};
+    };
+
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ConcurrentTrain& train) noexcept;
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard();
+
+        const Consist& Get() const noexcept { return *consist_; }
+
+    private:
+        std::atomic<size_t>* count_;
+        const Consist* consist_;
+    };
+
+    static constexpr size_t CellChunk = 1024;
+
+    std::atomic<Consist*> current_;
+    mutable ReaderCount readers_[ReaderStripes];
+    std::atomic<size_t> epoch_{0};
+
+    // Writer state, guarded by writerMutex_.
+    std::mutex writerMutex_;
+    std::vector<std::unique_ptr<std::atomic<size_t>[]>> cellChunks_;
+    size_t chunkUsed_ = CellChunk;
+    std::vector<std::atomic<size_t>*> freeCells_;
+
+    std::atomic<size_t>* NewCell(size_t occupied);
+    void Publish(Consist* next);
+    void Synchronize() noexcept;
+};
+
+} // namespace mgt
+
+#endif
@@ -0,0 +1,44 @@
+#include "fenwick_tree.hpp"
+
+namespace mgt {
+
+namespace {
+
+size_t LowBit(size_t i) noexcept { return i & (~i + 1); }
+
+} // namespace
+
+void FenwickTree::Add(size_t index, size_t delta) noexcept {
+    for (size_t i = index + 1; i < tree_.size(); i += LowBit(i))
+        tree_[i] += delta;
+}
+
+void FenwickTree::PushBack(size_t value) {
+    size_t i = tree_.size();
+    tree_.push_back(value + Prefix(i - 1) - Prefix(i - LowBit(i)));
+}
+
+size_t FenwickTree::Prefix(size_t count) const noexcept {
+    size_t sum = 0;
+    for (size_t i = count; i > 0; i -= LowBit(i))
+        sum += tree_[i];
+    return sum;
+}
+
+size_t FenwickTree::LowerBound(size_t target) const noexcept {
+    if (target == 0)
+        return 0;
+    size_t step = 1;
+    while (step * 2 <= Size())
+        step *= 2;
+    size_t pos = 0;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= Size() && tree_[pos + step] < target) {
+            pos += step;
+            target -= tree_[pos];
+        }
+    }
+    return pos + 1;
+}
+
+} // namespace mgt
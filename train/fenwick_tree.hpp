@@ -0,0 +1,45 @@
+#ifndef FENWICK_TREE_HPP_
+#define FENWICK_TREE_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace mgt {
+
+// Binary indexed tree over non-negative counts. Positions are 0-based; prefix
+// queries take the number of leading values. Decrements are passed as wrapped
+// size_t deltas, which is exact because every true prefix sum fits in size_t.
+class FenwickTree {
+public:
+    FenwickTree() = default;
+
+    // Rebuilds the tree in O(count) from weight(0) .. weight(count - 1).
+    template <typename Weight>
+    void Assign(size_t count, Weight weight) {
+        tree_.assign(count + 1, 0);
+        for (size_t i = 1; i <= count; ++i) {
+            tree_[i] += weight(i - 1);
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= count)
+                tree_[parent] += tree_[i];
+        }
+    }
+
+    [[nodiscard]] size_t Size() const noexcept { return tree_.size() - 1; }
+
+    void Add(size_t index, size_t delta) noexcept;
+    void PushBack(size_t value);
+    void PopBack() noexcept { tree_.pop_back(); }
+
+    // Sum of the first `count` values.
+    [[nodiscard]] size_t Prefix(size_t count) const noexcept;
+    // Smallest count with Prefix(count) >= target, or Size() + 1 if there is none.
+    [[nodiscard]] size_t LowerBound(size_t target) const noexcept;
+
+private:
+    std::vector<size_t> tree_ = std::vector<size_t>(1); // 1-based, tree_[0] unused
+};
+
+} // namespace mgt
+
+#endif
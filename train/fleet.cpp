@@ -0,0 +1,82 @@
+#include "fleet.hpp"
+#include <algorithm>
+#include <memory_resource>
+#include <numeric>
+
+namespace mgt {
+
+size_t Fleet::GetVanCount() const noexcept {
+    size_t vans = 0;
+    for (const Train& train : trains_)
+        vans += train.GetSize();
+    return vans;
+}
+
+OccupancyStats Fleet::StaffingPercentage() const noexcept {
+    OccupancyStats total;
+    for (const Train& train : trains_)
+        total += train.StaffingPercentage();
+    return total;
+}
+
+OccupancyStats Fleet::StaffingPercentage(ThreadPool& pool) const {
+    size_t tasks = (trains_.size() + StatsTrains - 1) / StatsTrains;
+    std::vector<OccupancyStats> partial(tasks);
+    pool.ParallelFor(tasks, [&](size_t task) {
+        size_t last = std::min(trains_.size(), (task + 1) * StatsTrains);
+        for (size_t i = task * StatsTrains; i < last; ++i)
+            partial[task] += trains_[i].StaffingPercentage();
+    });
+    OccupancyStats total;
+    for (const OccupancyStats& stats : partial)
+        total += stats;
+    return total;
+}
+
+template <typename Pass, typename Split>
+void Fleet::RunPass(ThreadPool& pool, Pass pass, Split split) {
+    std::vector<size_t> order(trains_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](size_t a, size_t b) { return trains_[a].GetSize() > trains_[b].GetSize(); });
+    size_t share = std::max(TaskVans, GetVanCount() / pool.GetThreadCount());
+    size_t splitCount = 0;
+    while (splitCount < order.size() && trains_[order[splitCount]].GetSize() > share)
+        ++splitCount;
+    std::vector<size_t> starts;
+    for (size_t i = splitCount, vans = TaskVans; i < order.size(); ++i) {
+        if (vans >= TaskVans) {
+            starts.push_back(i);
+            vans = 0;
+        }
+        vans += trains_[order[i]].GetSize() + 1;
+    }
+    starts.push_back(order.size());
+    pool.ParallelFor(starts.size() - 1, [&](size_t task) {
+        // Scratch memory is recycled across the trains and passes a thread runs.
+        thread_local std::pmr::unsynchronized_pool_resource scratch;
+        for (size_t i = starts[task]; i < starts[task + 1]; ++i)
+            pass(trains_[order[i]], &scratch);
+    });
+    // The pool is not reentrant, so split trains run after the batches, one at a time.
+    for (size_t i = 0; i < splitCount; ++i)
+        split(trains_[order[i]], pool);
+}
+
+void Fleet::BalanceOccupancy(ThreadPool& pool) {
+    RunPass(pool, [](Train& train, std::pmr::memory_resource* scratch) { train.BalanceOccupancy(scratch); },
+            [](Train& train, ThreadPool& pool) { train.BalanceOccupancy(pool); });
+}
+
+void Fleet::MinimizeVans(ThreadPool& pool) {
+    // The pool already keeps every thread busy; extra threads per train would only compete.
+    RunPass(pool, [](Train& train, std::pmr::memory_resource*) { train.MinimizeVans(1); },
+            [](Train& train, ThreadPool& pool) { train.MinimizeVans(pool); });
+}
+
+void Fleet::PlaceRestaurantVanOptimally(ThreadPool& pool) {
+    RunPass(pool, [](Train& train, std::pmr::memory_resource* scratch) { train.PlaceRestaurantVanOptimally(scratch); },
+            [](Train& train, ThreadPool& pool) { train.PlaceRestaurantVanOptimally(pool); });
+}
+
+} // namespace mgt
@@ -0,0 +1,75 @@
+#ifndef FLEET_HPP_
+#define FLEET_HPP_
+
+#include "occupancy_stats.hpp"
+#include "thread_pool.hpp"
+#include "train.hpp"
+#include <stdexcept>
+#include <vector>
+
+namespace mgt {
+
+// Owns many trains and runs the optimizers over all of them on a ThreadPool. Small trains
+// are batched into tasks; a train too large to balance that way has its per-van loops
+// split into chunks over the whole pool (see the Train overloads taking a ThreadPool).
+// Either way a train gets exactly the result of calling the Train method, so the results
+// do not depend on the number of threads.
+class Fleet {
+private:
+    std::vector<Train> trains_;
+
+    // Trains are grouped into tasks of at least this many vans; larger trains get a task
+    // of their own, and tasks are queued largest first so stealing evens out the tail.
+    // A train above this size that also holds more than one thread's share of the fleet's
+    // vans would keep one thread busy after the rest ran out of work, so it is split instead.
+    static constexpr size_t TaskVans = 1 << 14;
+
+    // StaffingPercentage(pool) adds up this many trains' cached totals per task.
+    static constexpr size_t StatsTrains = 1 << 10;
+
+    // pass(train, scratch) runs a batched train; split(train, pool) a split one.
+    template <typename Pass, typename Split>
+    void RunPass(ThreadPool& pool, Pass pass, Split split);
+
+public:
+    Fleet() = default;
+
+    Fleet& operator+=(Train train) {
+        trains_.push_back(std::move(train));
+        return *this;
+    }
+
+    Train& operator[](size_t index) {
+        if (index >= trains_.size())
+            throw std::out_of_range("Index out of fleet range");
+        return trains_[index];
+    }
+
+    const Train& operator[](size_t index) const {
+        if (index >= trains_.size())
+            throw std::out_of_range("Index out of fleet range");
+        return trains_[index];
+    }
+
+    void RemoveTrain(size_t index) {
+        if (index >= trains_.size())
+            throw std::out_of_range("Index out of fleet range");
+        trains_.erase(trains_.begin() + static_cast<std::ptrdiff_t>(index));
+    }
+
+    size_t GetSize() const noexcept { return trains_.size(); }
+
+    size_t GetVanCount() const noexcept;
+
+    // Per-type totals over every train in the fleet.
+    [[nodiscard]] OccupancyStats StaffingPercentage() const noexcept;
+    [[nodiscard]] OccupancyStats StaffingPercentage(ThreadPool& pool) const;
+
+    void BalanceOccupancy(ThreadPool& pool);
+    void MinimizeVans(ThreadPool& pool);
+    void PlaceRestaurantVanOptimally(ThreadPool& pool);
+};
+
+} // namespace mgt
+
+#endif
@@ -0,0 +1,195 @@
+#include "manifest.hpp"
+#include <algorithm>
+#include <memory>
+
+namespace mgt {
+
+namespace {
+
+bool IsSpace(char c) noexcept { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+bool IsDelimiter(char c) noexcept { return c == ',' || c == '}'; }
+
+} // namespace
+
+ParseStatus ManifestParser::Fail(size_t position, const char* message) {
+    error_ = {position, message};
+    return error_;
+}
+
+// Parses text that ends right after a delimiter (or at the end of input), so no van is cut short.
+ParseStatus ManifestParser::Parse(std::string_view text, size_t offset) {
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && IsSpace(text[pos]))
+            ++pos;
+        if (pos == text.size())
+            return {};
+        char c = text[pos];
+        switch (state_) {
+        case State::Open:
+            if (c != '{')
+                return Fail(offset + pos, "expected '{'");
+            state_ = State::FirstVan;
+            ++pos;
+            break;
+        case State::FirstVan:
+        case State::Van:
+            if (c == '}' && state_ == State::FirstVan) {
+                state_ = State::Done;
+                ++pos;
+                break;
+            }
+            {
+                Van van;
+                if (ParseStatus status = ParseVan(text, pos, van); !status)
+                    return Fail(offset + status.position, status.message);
+                train_ += van;
+                state_ = State::Separator;
+            }
+            break;
+        case State::Separator:
+            if (!IsDelimiter(c))
+                return Fail(offset + pos, "expected ',' or '}'");
+            state_ = c == ',' ? State::Van : State::Done;
+            ++pos;
+            break;
+        case State::Done:
+            return Fail(offset + pos, "unexpected text after '}'");
+        }
+    }
+}
+
+// Whitespace before the carried text is dropped, and every other run of it is kept as a
+// single byte, so only token bytes count against MaxCarry. gaps_ remembers where runs
+// were shortened so that error positions still point into the original input.
+bool ManifestParser::Carry(std::string_view text) {
+    for (char c : text) {
+        if (IsSpace(c) && carry_.empty()) {
+            ++consumed_;
+            continue;
+        }
+        if (IsSpace(c) && IsSpace(carry_.back())) {
+            ++skipped_;
+            if (gaps_.empty() || gaps_.back().first != carry_.size())
+                gaps_.emplace_back(carry_.size(), skipped_);
+            else
+                gaps_.back().second = skipped_;
+            continue;
+        }
+        if (carry_.size() == MaxCarry)
+            return false;
+        carry_.push_back(c);
+    }
+    return true;
+}
+
+ParseStatus ManifestParser::ParseCarry() {
+    if (ParseStatus status = Parse(carry_, consumed_); !status) {
+        size_t pos = status.position - consumed_, shift = 0;
+        for (const auto& [at, skipped] : gaps_) {
+            if (at <= pos)
+                shift = skipped;
+        }
+        error_.position += shift;
+        return error_;
+    }
+    consumed_ += carry_.size() + skipped_;
+    carry_.clear();
+    gaps_.clear();
+    skipped_ = 0;
+    return {};
+}
+
+ParseStatus ManifestParser::Feed(std::string_view chunk) {
+    if (!error_)
+        return error_;
+    if (!carry_.empty()) {
+        auto delimiter = std::find_if(chunk.begin(), chunk.end(), IsDelimiter);
+        size_t take = delimiter == chunk.end() ? chunk.size() : static_cast<size_t>(delimiter - chunk.begin()) + 1;
+        if (!Carry(chunk.substr(0, take)))
+            return Fail(consumed_, "token too long");
+        if (delimiter == chunk.end())
+            return {};
+        if (ParseStatus status = ParseCarry(); !status)
+            return status;
+        chunk.remove_prefix(take);
+    }
+    size_t last = chunk.find_last_of(",}");
+    size_t complete = last == std::string_view::npos ? 0 : last + 1;
+    // Past the closing '}' only whitespace may follow, and it never needs carrying.
+    if (state_ == State::Done)
+        complete = chunk.size();
+    if (ParseStatus status = Parse(chunk.substr(0, complete), consumed_); !status)
+        return status;
+    consumed_ += complete;
+    if (!Carry(chunk.substr(complete)))
+        return Fail(consumed_, "token too long");
+    return {};
+}
+
+ParseStatus ManifestParser::Finish() {
+    if (!error_)
+        return error_;
+    if (ParseStatus status = ParseCarry(); !status)
+        return status;
+    if (state_ != State::Done)
+        return Fail(consumed_, state_ == State::Open ? "expected '{'" : "expected '}'");
+    return {};
+}
+
+size_t ManifestWriter::Write(std::span<char> buffer) noexcept {
+    char* out = buffer.data();
+    char* end = out + buffer.size();
+    if (!opened_ && out != end) {
+        *out++ = '{';
+        opened_ = true;
+    }
+    while (opened_ && next_ < train_.GetSize() && static_cast<size_t>(end - out) >= MinBuffer) {
+        if (next_ > 0) {
+            *out++ = ',';
+            *out++ = ' ';
+        }
+        out = FormatVan(out, train_.UncheckedAt(next_++));
+    }
+    if (opened_ && !closed_ && next_ == train_.GetSize() && out != end) {
+        *out++ = '}';
+        closed_ = true;
+    }
+    return static_cast<size_t>(out - buffer.data());
+}
+
+namespace {
+
+// Drops the vans a failed parse had already appended.
+ParseStatus RollBack(Train& train, size_t size, ParseStatus status) {
+    if (!status)
+        train.EraseRange(size, train.GetSize());
+    return status;
+}
+
+} // namespace
+
+ParseStatus ParseTrain(std::string_view text, Train& train) {
+    size_t size = train.GetSize();
+    train.Reserve(size + static_cast<size_t>(std::count(text.begin(), text.end(), ',')) + 1);
+    ManifestParser parser(train);
+    if (ParseStatus status = parser.Feed(text); !status)
+        return RollBack(train, size, status);
+    return RollBack(train, size, parser.Finish());
+}
+
+ParseStatus ReadTrain(std::istream& is, Train& train) {
+    const size_t BLOCK_SIZE = 1 << 20;
+    std::unique_ptr<char[]> block(new char[BLOCK_SIZE]);
+    size_t size = train.GetSize();
+    ManifestParser parser(train);
+    while (is) {
+        is.read(block.get(), BLOCK_SIZE);
+        if (ParseStatus status = parser.Feed(std::string_view(block.get(), static_cast<size_t>(is.gcount()))); !status)
+            return RollBack(train, size, status);
+    }
+    return RollBack(train, size, parser.Finish());
+}
+
+} // namespace mgt
@@ -0,0 +1,79 @@
+#ifndef MANIFEST_HPP_
+#define MANIFEST_HPP_
+
+#include "../van/van.hpp"
+#include "train.hpp"
+#include <istream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mgt {
+
+// Incremental reader for the Train::Write format, "{o/c type, o/c type, ...}", with any
+// whitespace between tokens. Text can arrive in chunks of any size; parsed vans are
+// appended to the target train as they complete. Nothing throws except allocation
+// failure, and errors carry the byte offset from the start of the whole input.
+class ManifestParser {
+public:
+    explicit ManifestParser(Train& train) noexcept : train_(train) {}
+
+    ParseStatus Feed(std::string_view chunk);
+    // Call once the input is exhausted: checks that the closing '}' was seen.
+    ParseStatus Finish();
+
+private:
+    enum class State { Open, FirstVan, Van, Separator, Done };
+
+    // A van split across chunks is held here until its terminating delimiter arrives.
+    static constexpr size_t MaxCarry = 4096;
+
+    Train& train_;
+    State state_ = State::Open;
+    std::string carry_;
+    std::vector<std::pair<size_t, size_t>> gaps_; // (carry_ offset, whitespace skipped before it so far)
+    size_t skipped_ = 0;   // whitespace bytes dropped from inside carry_
+    size_t consumed_ = 0;  // bytes of input before carry_
+    ParseStatus error_;
+
+    ParseStatus Parse(std::string_view text, size_t offset);
+    ParseStatus Fail(size_t position, const char* message);
+    bool Carry(std::string_view text);
+    ParseStatus ParseCarry();
+};
+
+// Renders a train in Write format into caller-supplied buffers a chunk at a time, so a
+// huge consist can be streamed out without ever holding its whole text.
+class ManifestWriter {
+public:
+    // Every buffer passed to Write must hold at least this many bytes.
+    static constexpr size_t MinBuffer = MaxVanChars + 2;
+
+    explicit ManifestWriter(const Train& train) noexcept : train_(train) {}
+
+    // Fills the front of `buffer` with the next part of the text and returns its length;
+    // returns 0 once everything has been written.
+    size_t Write(std::span<char> buffer) noexcept;
+
+    [[nodiscard]] bool Done() const noexcept { return closed_; }
+
+private:
+    const Train& train_;
+    size_t next_ = 0;
+    bool opened_ = false;
+    bool closed_ = false;
+};
+
+// Appends every van of a complete manifest to `train`. On failure the train keeps only
+// the vans it had before.
+ParseStatus ParseTrain(std::string_view text, Train& train);
+
+// Streams a manifest from `is` in large blocks and appends its vans to `train`, with the
+// same rollback on failure as ParseTrain.
+ParseStatus ReadTrain(std::istream& is, Train& train);
+
+} // namespace mgt
+
+#endif
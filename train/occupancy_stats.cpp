@@ -0,0 +1,170 @@
+#include "occupancy_stats.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MGT_AVX2_KERNELS 1
+#include <immintrin.h>
+#else
+#define MGT_AVX2_KERNELS 0
+#endif
+
+namespace mgt {
+
+static_assert(sizeof(VanType) == 4, "AVX2 kernels widen the type column from 32-bit lanes");
+
+namespace {
+
+OccupancyStats SumOccupancyScalar(const size_t* capacities, const size_t* occupied, const VanType* types, size_t count) noexcept {
+    OccupancyStats stats;
+    for (size_t i = 0; i < count; ++i) {
+        TypeStats& stat = stats.types[static_cast<size_t>(types[i])];
+        ++stat.vans;
+        stat.capacity += capacities[i];
+        stat.occupied += occupied[i];
+        stats.seatingVans += capacities[i] > 0;
+    }
+    return stats;
+}
+
+size_t CountSeatingScalar(const size_t* capacities, size_t count) noexcept {
+    size_t seating = 0;
+    for (size_t i = 0; i < count; ++i)
+        seating += capacities[i] > 0;
+    return seating;
+}
+
+size_t RateScalar(size_t capacity, size_t occupied) noexcept {
+    return capacity ? static_cast<size_t>((static_cast<double>(occupied) / static_cast<double>(capacity)) * 100) : 0;
+}
+
+void ComputeOccupancyRatesScalar(const size_t* capacities, const size_t* occupied, size_t count, size_t* rates) noexcept {
+    for (size_t i = 0; i < count; ++i)
+        rates[i] = RateScalar(capacities[i], occupied[i]);
+}
+
+#if MGT_AVX2_KERNELS
+
+__attribute__((target("avx2"))) size_t HorizontalSum(__m256i v) noexcept {
+    alignas(32) unsigned long long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2")))
+OccupancyStats SumOccupancyAvx2(const size_t* capacities, const size_t* occupied, const VanType* types, size_t count) noexcept {
+    __m256i capacity[VanTypeCount], seats[VanTypeCount], vans[VanTypeCount], typeKey[VanTypeCount];
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        capacity[t] = seats[t] = vans[t] = _mm256_setzero_si256();
+        typeKey[t] = _mm256_set1_epi64x(static_cast<long long>(t));
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i empty = zero;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i cap = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(capacities + i));
+        __m256i occ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(occupied + i));
+        __m256i type = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(types + i)));
+        for (size_t t = 0; t < VanTypeCount; ++t) {
+            __m256i match = _mm256_cmpeq_epi64(type, typeKey[t]);
+            capacity[t] = _mm256_add_epi64(capacity[t], _mm256_and_si256(match, cap));
+            seats[t] = _mm256_add_epi64(seats[t], _mm256_and_si256(match, occ));
+            vans[t] = _mm256_sub_epi64(vans[t], match);
+        }
+        empty = _mm256_sub_epi64(empty, _mm256_cmpeq_epi64(cap, zero));
+    }
+
+    OccupancyStats stats = SumOccupancyScalar(capacities + i, occupied + i, types + i, count - i);
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        stats.types[t].vans += HorizontalSum(vans[t]);
+        stats.types[t].capacity += HorizontalSum(capacity[t]);
+        stats.types[t].occupied += HorizontalSum(seats[t]);
+    }
+    stats.seatingVans += i - HorizontalSum(empty);
+    return stats;
+}
+
+__attribute__((target("avx2"))) size_t CountSeatingAvx2(const size_t* capacities, size_t count) noexcept {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i empty = zero;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i cap = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(capacities + i));
+        empty = _mm256_sub_epi64(empty, _mm256_cmpeq_epi64(cap, zero));
+    }
+    return i - HorizontalSum(empty) + CountSeatingScalar(capacities + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void ComputeOccupancyRatesAvx2(const size_t* capacities, const size_t* occupied, size_t count, size_t* rates) noexcept {
+    // Integers below 2^52 convert exactly by splicing them into the mantissa of 2^52.
+    const __m256i exponent = _mm256_set1_epi64x(0x4330000000000000LL);
+    const __m256d bias = _mm256_set1_pd(4503599627370496.0);
+    const __m256i highBits = _mm256_set1_epi64x(static_cast<long long>(~((1ULL << 52) - 1)));
+    const __m256d hundred = _mm256_set1_pd(100.0);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i cap = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(capacities + i));
+        __m256i occ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(occupied + i));
+        if (!_mm256_testz_si256(_mm256_or_si256(cap, occ), highBits)) {
+            ComputeOccupancyRatesScalar(capacities + i, occupied + i, 4, rates + i);
+            continue;
+        }
+        __m256d capD = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(cap, exponent)), bias);
+        __m256d occD = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(occ, exponent)), bias);
+        __m256d rate = _mm256_mul_pd(_mm256_div_pd(occD, capD), hundred);
+        rate = _mm256_andnot_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(cap, zero)), rate);
+        __m256i rate64 = _mm256_cvtepu32_epi64(_mm256_cvttpd_epi32(rate));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rates + i), rate64);
+    }
+    ComputeOccupancyRatesScalar(capacities + i, occupied + i, count - i, rates + i);
+}
+
+#endif
+
+} // namespace
+
+size_t FindLeastOccupied(const size_t* capacities, const size_t* occupied, size_t count, size_t seats) noexcept {
+    size_t best = count;
+    for (size_t i = 0; i < count; ++i) {
+        if (seats <= capacities[i] - occupied[i] && (best == count || occupied[i] < occupied[best]))
+            best = i;
+    }
+    return best;
+}
+
+bool HasAvx2() noexcept {
+#if MGT_AVX2_KERNELS
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+OccupancyStats SumOccupancy(const size_t* capacities, const size_t* occupied, const VanType* types, size_t count) noexcept {
+#if MGT_AVX2_KERNELS
+    if (HasAvx2())
+        return SumOccupancyAvx2(capacities, occupied, types, count);
+#endif
+    return SumOccupancyScalar(capacities, occupied, types, count);
+}
+
+size_t CountSeating(const size_t* capacities, size_t count) noexcept {
+#if MGT_AVX2_KERNELS
+    if (HasAvx2())
+        return CountSeatingAvx2(capacities, count);
+#endif
+    return CountSeatingScalar(capacities, count);
+}
+
+void ComputeOccupancyRates(const size_t* capacities, const size_t* occupied, size_t count, size_t* rates) noexcept {
+#if MGT_AVX2_KERNELS
+    if (HasAvx2())
+        return ComputeOccupancyRatesAvx2(capacities, occupied, count, rates);
+#endif
+    ComputeOccupancyRatesScalar(capacities, occupied, count, rates);
+}
+
+} // namespace mgt
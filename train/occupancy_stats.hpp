@@ -0,0 +1,72 @@
+#ifndef OCCUPANCY_STATS_HPP_
+#define OCCUPANCY_STATS_HPP_
+
+#include "../van/van.hpp"
+#include <cstddef>
+
+namespace mgt {
+
+struct TypeStats {
+    size_t vans = 0;
+    size_t capacity = 0;
+    size_t occupied = 0;
+};
+
+struct OccupancyStats {
+    TypeStats types[VanTypeCount]{};
+    size_t seatingVans = 0; // vans with capacity > 0
+
+    OccupancyStats& operator+=(const OccupancyStats& other) noexcept {
+        for (size_t t = 0; t < VanTypeCount; ++t) {
+            types[t].vans += other.types[t].vans;
+            types[t].capacity += other.types[t].capacity;
+            types[t].occupied += other.types[t].occupied;
+        }
+        seatingVans += other.seatingVans;
+        return *this;
+    }
+
+    [[nodiscard]] const TypeStats& operator[](VanType type) const noexcept {
+        return types[static_cast<size_t>(type)];
+    }
+
+    [[nodiscard]] size_t TotalCapacity() const noexcept {
+        size_t total = 0;
+        for (const TypeStats& stat : types)
+            total += stat.capacity;
+        return total;
+    }
+
+    [[nodiscard]] size_t TotalOccupied() const noexcept {
+        size_t total = 0;
+        for (const TypeStats& stat : types)
+            total += stat.occupied;
+        return total;
+    }
+
+    // Passengers counted by PlaceRestaurantVanOptimally: everyone outside luxury vans.
+    [[nodiscard]] size_t NonLuxuryOccupied() const noexcept {
+        return TotalOccupied() - (*this)[VanType::Luxury].occupied;
+    }
+
+    // Same rounding as Van::OccupancyRate, applied to the whole type group.
+    [[nodiscard]] size_t Percentage(VanType type) const noexcept {
+        const TypeStats& stat = (*this)[type];
+        return stat.capacity ? static_cast<size_t>((static_cast<double>(stat.occupied) / static_cast<double>(stat.capacity)) * 100) : 0;
+    }
+};
+
+// Column kernels. Each one picks an AVX2 implementation at runtime when the CPU
+// supports it and falls back to a portable scalar loop otherwise; both give identical results.
+OccupancyStats SumOccupancy(const size_t* capacities, const size_t* occupied, const VanType* types, size_t count) noexcept;
+size_t CountSeating(const size_t* capacities, size_t count) noexcept;
+void ComputeOccupancyRates(const size_t* capacities, const size_t* occupied, size_t count, size_t* rates) noexcept;
+
+// First van with the fewest occupied seats among those with at least `seats` free, or count if none.
+size_t FindLeastOccupied(const size_t* capacities, const size_t* occupied, size_t count, size_t seats) noexcept;
+
+bool HasAvx2() noexcept;
+
+} // namespace mgt
+
+#endif
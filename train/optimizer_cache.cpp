@@ -0,0 +1,66 @@
+#include "optimizer_cache.hpp"
+#include <stdexcept>
+#include <utility>
+
+namespace mgt {
+
+OptimizerCache::OptimizerCache(size_t capacity) : capacity_(capacity) {
+    if (capacity == 0)
+        throw std::invalid_argument("Error: Optimizer cache capacity must be positive.");
+}
+
+template <typename Run>
+void OptimizerCache::Apply(Train& train, Pass pass, Run run) {
+    Key key{train.GetContentHash(), pass};
+    auto found = index_.find(key);
+    if (found != index_.end() && found->second->input == train) {
+        ++hits_;
+        entries_.splice(entries_.begin(), entries_, found->second);
+        bool seatIndexed = train.HasSeatIndex(), placementIndexed = train.HasPlacementIndex();
+        train = found->second->output;
+        if (seatIndexed)
+            train.EnableSeatIndex();
+        if (placementIndexed)
+            train.EnablePlacementIndex();
+        return;
+    }
+
+    ++misses_;
+    // Cached trains carry no indexes: they are only compared and copied.
+    Train input = train.CopyVans();
+    run(train);
+    Entry entry{key, std::move(input), train.CopyVans()};
+    if (found != index_.end()) {
+        // Same hash, different train: the newer one takes the slot.
+        *found->second = std::move(entry);
+        entries_.splice(entries_.begin(), entries_, found->second);
+        return;
+    }
+    entries_.push_front(std::move(entry));
+    index_.emplace(key, entries_.begin());
+    if (entries_.size() > capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
+void OptimizerCache::BalanceOccupancy(Train& train) {
+    Apply(train, Pass::BalanceOccupancy, [](Train& t) { t.BalanceOccupancy(); });
+}
+
+void OptimizerCache::MinimizeVans(Train& train) {
+    Apply(train, Pass::MinimizeVans, [](Train& t) { t.MinimizeVans(); });
+}
+
+void OptimizerCache::PlaceRestaurantVanOptimally(Train& train) {
+    Apply(train, Pass::PlaceRestaurantVanOptimally, [](Train& t) { t.PlaceRestaurantVanOptimally(); });
+}
+
+void OptimizerCache::Clear() noexcept {
+    index_.clear();
+    entries_.clear();
+    hits_ = 0;
+    misses_ = 0;
+}
+
+} // namespace mgt
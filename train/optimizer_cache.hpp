@@ -0,0 +1,75 @@
+#ifndef OPTIMIZER_CACHE_HPP_
+#define OPTIMIZER_CACHE_HPP_
+
+#include "train.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+namespace mgt {
+
+// Remembers what the whole-train optimizers did to recently seen trains, so running one
+// again on a train whose content has not changed copies the stored result instead of
+// optimizing. Entries are keyed by Train::GetContentHash and the optimizer; a hit is
+// confirmed against the stored input, so a hash collision only ever costs a miss.
+// The least recently used entry is dropped once the cache is full. Not thread-safe.
+class OptimizerCache {
+public:
+    // `capacity` is the number of results kept, each holding a copy of the train before
+    // and after the optimizer.
+    explicit OptimizerCache(size_t capacity);
+
+    // Same result as the Train methods of the same name. The train keeps whichever
+    // indexes it had enabled.
+    void BalanceOccupancy(Train& train);
+    void MinimizeVans(Train& train);
+    void PlaceRestaurantVanOptimally(Train& train);
+
+    [[nodiscard]] size_t GetHits() const noexcept { return hits_; }
+    [[nodiscard]] size_t GetMisses() const noexcept { return misses_; }
+    [[nodiscard]] size_t GetSize() const noexcept { return entries_.size(); }
+    [[nodiscard]] size_t GetCapacity() const noexcept { return capacity_; }
+
+    // Drops every entry and resets the counters.
+    void Clear() noexcept;
+
+private:
+    enum class Pass : uint8_t {
+        BalanceOccupancy,
+        MinimizeVans,
+        PlaceRestaurantVanOptimally
+    };
+
+    struct Key {
+        uint64_t hash;
+        Pass pass;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept {
+            return static_cast<size_t>(key.hash + static_cast<uint64_t>(key.pass));
+        }
+    };
+
+    struct Entry {
+        Key key;
+        Train input;
+        Train output;
+    };
+
+    size_t capacity_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Entry> entries_; // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+
+    template <typename Run>
+    void Apply(Train& train, Pass pass, Run run);
+};
+
+} // namespace mgt
+
+#endif
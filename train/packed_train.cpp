@@ -0,0 +1,19 @@
+#include "packed_train.hpp"
+
+namespace mgt {
+
+PackedTrain::PackedTrain(const Train& train) {
+    vans_.reserve(train.GetSize());
+    for (size_t i = 0; i < train.GetSize(); ++i)
+        vans_.emplace_back(train[i]);
+}
+
+Train PackedTrain::Unpack(std::pmr::memory_resource* resource) const {
+    Train train(resource);
+    train.Reserve(vans_.size());
+    for (const PackedVan& van : vans_)
+        train += van.ToVan();
+    return train;
+}
+
+} // namespace mgt
@@ -0,0 +1,59 @@
+#ifndef PACKED_TRAIN_HPP_
+#define PACKED_TRAIN_HPP_
+
+#include "../van/packed_van.hpp"
+#include "train.hpp"
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace mgt {
+
+// Separate container for trains that are kept rather than operated on, such as fleet
+// history: four bytes per van instead of Train's twenty. It is not a storage mode of
+// Train: Train's kernels, indexes and optimizers all work on its full-width columns, so
+// PackedTrain has none of that API. Unpack into a Train to board or optimize it.
+class PackedTrain {
+private:
+    std::vector<PackedVan> vans_;
+
+public:
+    PackedTrain() = default;
+
+    // Throws std::out_of_range if a van has more than PackedVan::MaxSeats seats.
+    explicit PackedTrain(const Train& train);
+
+    [[nodiscard]] Train Unpack(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+    PackedTrain& operator+=(const Van& van) {
+        vans_.emplace_back(van);
+        return *this;
+    }
+
+    PackedVan& operator[](size_t index) {
+        if (index >= vans_.size())
+            throw std::out_of_range("Index out of train range");
+        return vans_[index];
+    }
+
+    const PackedVan& operator[](size_t index) const {
+        if (index >= vans_.size())
+            throw std::out_of_range("Index out of train range");
+        return vans_[index];
+    }
+
+    [[nodiscard]] std::span<const PackedVan> Vans() const noexcept { return vans_; }
+
+    size_t GetSize() const noexcept { return vans_.size(); }
+
+    void Reserve(size_t count) { vans_.reserve(count); }
+
+    void ShrinkToFit() { vans_.shrink_to_fit(); }
+
+    bool operator==(const PackedTrain& other) const = default;
+};
+
+} // namespace mgt
+
+#endif
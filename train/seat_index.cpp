@@ -0,0 +1,89 @@
+#include "seat_index.hpp"
+#include <algorithm>
+
+namespace mgt {
+
+SeatIndex::SeatIndex(const size_t* capacities, const size_t* occupied, size_t count) {
+    size_t maxCapacity = 0;
+    for (size_t i = 0; i < count; ++i)
+        maxCapacity = std::max(maxCapacity, capacities[i]);
+    Grow(maxCapacity);
+    for (size_t i = 0; i < count; ++i)
+        buckets_[capacities[i] - occupied[i]].emplace(occupied[i], i);
+    Rebuild();
+}
+
+void SeatIndex::Grow(size_t capacity) {
+    if (capacity < leaves_)
+        return;
+    size_t leaves = leaves_ ? leaves_ : 1;
+    while (leaves <= capacity)
+        leaves *= 2;
+    buckets_.resize(leaves);
+    tree_.assign(2 * leaves, Empty);
+    leaves_ = leaves;
+    Rebuild();
+}
+
+void SeatIndex::Rebuild() noexcept {
+    for (size_t f = 0; f < leaves_; ++f)
+        tree_[leaves_ + f] = buckets_[f].empty() ? Empty : *buckets_[f].begin();
+    for (size_t node = leaves_ - 1; node > 0; --node)
+        tree_[node] = std::min(tree_[2 * node], tree_[2 * node + 1]);
+}
+
+void SeatIndex::Refresh(size_t freeSeats) noexcept {
+    size_t node = leaves_ + freeSeats;
+    tree_[node] = buckets_[freeSeats].empty() ? Empty : *buckets_[freeSeats].begin();
+    for (node /= 2; node > 0; node /= 2)
+        tree_[node] = std::min(tree_[2 * node], tree_[2 * node + 1]);
+}
+
+void SeatIndex::Insert(size_t index, size_t capacity, size_t occupied) {
+    size_t freeSeats = capacity - occupied;
+    Grow(capacity);
+    buckets_[freeSeats].emplace(occupied, index);
+    Refresh(freeSeats);
+}
+
+void SeatIndex::Erase(size_t index, size_t capacity, size_t occupied) noexcept {
+    size_t freeSeats = capacity - occupied;
+    buckets_[freeSeats].erase(Key{occupied, index});
+    Refresh(freeSeats);
+}
+
+void SeatIndex::Update(size_t index, size_t oldCapacity, size_t oldOccupied, size_t newCapacity, size_t newOccupied) {
+    size_t oldFree = oldCapacity - oldOccupied, newFree = newCapacity - newOccupied;
+    Grow(newCapacity);
+    // Buckets already cover every capacity in the train and the set node is reused, so an
+    // update that keeps the capacity never allocates.
+    auto node = buckets_[oldFree].extract(Key{oldOccupied, index});
+    node.value() = Key{newOccupied, index};
+    buckets_[newFree].insert(std::move(node));
+    Refresh(oldFree);
+    if (newFree != oldFree)
+        Refresh(newFree);
+}
+
+void SeatIndex::Renumber(size_t from, size_t to, size_t capacity, size_t occupied) noexcept {
+    size_t freeSeats = capacity - occupied;
+    auto node = buckets_[freeSeats].extract(Key{occupied, from});
+    node.value() = Key{occupied, to};
+    buckets_[freeSeats].insert(std::move(node));
+    Refresh(freeSeats);
+}
+
+size_t SeatIndex::FindBestFit(size_t seats) const noexcept {
+    if (seats >= leaves_)
+        return npos;
+    Key best = Empty;
+    for (size_t lo = leaves_ + seats, hi = 2 * leaves_; lo < hi; lo /= 2, hi /= 2) {
+        if (lo & 1)
+            best = std::min(best, tree_[lo++]);
+        if (hi & 1)
+            best = std::min(best, tree_[--hi]);
+    }
+    return best.second;
+}
+
+} // namespace mgt
@@ -0,0 +1,49 @@
+#ifndef SEAT_INDEX_HPP_
+#define SEAT_INDEX_HPP_
+
+#include <cstddef>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace mgt {
+
+// Best-fit lookup for Train::SitInMin. Vans are bucketed by free seats; each bucket is
+// ordered by (occupied seats, van index) and a min segment tree over the buckets answers
+// "fewest occupied seats among vans with at least n free" in O(log n + log F), where F is
+// the largest capacity in the train. Memory grows with F, which is fine for seat counts.
+class SeatIndex {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    SeatIndex() = default;
+    SeatIndex(const size_t* capacities, const size_t* occupied, size_t count);
+
+    void Insert(size_t index, size_t capacity, size_t occupied);
+    void Erase(size_t index, size_t capacity, size_t occupied) noexcept;
+    // Only allocates when newCapacity is larger than any capacity indexed so far, so an
+    // occupancy change on a van already in the index cannot throw.
+    void Update(size_t index, size_t oldCapacity, size_t oldOccupied, size_t newCapacity, size_t newOccupied);
+    // Re-keys a van that moved from slot `from` to slot `to` without changing.
+    void Renumber(size_t from, size_t to, size_t capacity, size_t occupied) noexcept;
+
+    // Index of the first van with the fewest occupied seats that has at least `seats` free, or npos.
+    [[nodiscard]] size_t FindBestFit(size_t seats) const noexcept;
+
+private:
+    using Key = std::pair<size_t, size_t>; // (occupied seats, van index)
+
+    static constexpr Key Empty{npos, npos};
+
+    std::vector<std::set<Key>> buckets_;
+    std::vector<Key> tree_;
+    size_t leaves_ = 0;
+
+    void Grow(size_t capacity);
+    void Rebuild() noexcept;
+    void Refresh(size_t freeSeats) noexcept;
+};
+
+} // namespace mgt
+
+#endif
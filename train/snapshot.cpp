@@ -0,0 +1,246 @@
+#include "snapshot.hpp"
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mgt {
+
+// Snapshots are the in-memory columns written out verbatim, which is only the
+// documented little-endian, 64-bit format on such hosts.
+static_assert(std::endian::native == std::endian::little, "snapshots are written and mapped in little-endian order");
+static_assert(sizeof(size_t) == sizeof(uint64_t) && sizeof(VanType) == sizeof(uint32_t));
+
+namespace {
+
+constexpr size_t Padding(size_t bytes) noexcept { return (8 - bytes % 8) % 8; }
+
+size_t SectionSize(size_t vanCount) noexcept {
+    size_t types = vanCount * sizeof(VanType);
+    return sizeof(SnapshotTrainHeader) + 2 * vanCount * sizeof(uint64_t) + types + Padding(types);
+}
+
+// Word-at-a-time FNV-1a variant. The checksummed region is a multiple of 8 bytes,
+// and it is fed in pieces whose lengths need not be, so partial words are carried.
+class Checksum {
+public:
+    void Add(const void* data, size_t length) noexcept {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        while (length > 0 && pending_ > 0) {
+            Push(*bytes++);
+            --length;
+        }
+        for (; length >= 8; bytes += 8, length -= 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            Mix(word);
+        }
+        while (length-- > 0)
+            Push(*bytes++);
+    }
+
+    [[nodiscard]] uint64_t Value() const noexcept { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+    uint64_t partial_ = 0;
+    unsigned pending_ = 0;
+
+    void Mix(uint64_t word) noexcept {
+        hash_ = (hash_ ^ word) * 1099511628211ull;
+        hash_ ^= hash_ >> 29;
+    }
+
+    void Push(unsigned char byte) noexcept {
+        partial_ |= static_cast<uint64_t>(byte) << (8 * pending_);
+        if (++pending_ == 8) {
+            Mix(partial_);
+            partial_ = 0;
+            pending_ = 0;
+        }
+    }
+};
+
+SnapshotTrainHeader MakeTrainHeader(const Train& train) noexcept {
+    SnapshotTrainHeader header{};
+    const OccupancyStats& stats = train.StaffingPercentage();
+    header.vanCount = train.GetSize();
+    header.seatingVans = stats.seatingVans;
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        header.vans[t] = stats.types[t].vans;
+        header.capacity[t] = stats.types[t].capacity;
+        header.occupied[t] = stats.types[t].occupied;
+    }
+    return header;
+}
+
+// Emits everything after the file header, in order, to `sink(data, length)`.
+template <typename Sink>
+void EmitBody(std::span<const Train* const> trains, Sink sink) {
+    static const char zeros[8] = {};
+    uint64_t offset = sizeof(SnapshotHeader) + trains.size() * sizeof(uint64_t);
+    for (const Train* train : trains) {
+        sink(&offset, sizeof(offset));
+        offset += SectionSize(train->GetSize());
+    }
+    for (const Train* train : trains) {
+        SnapshotTrainHeader header = MakeTrainHeader(*train);
+        sink(&header, sizeof(header));
+        sink(train->Capacities().data(), train->Capacities().size_bytes());
+        sink(train->OccupiedSeats().data(), train->OccupiedSeats().size_bytes());
+        sink(train->Types().data(), train->Types().size_bytes());
+        sink(zeros, Padding(train->Types().size_bytes()));
+    }
+}
+
+} // namespace
+
+void WriteSnapshot(std::ostream& os, std::span<const Train* const> trains) {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SnapshotHeader::Magic, sizeof(header.magic));
+    header.version = SnapshotHeader::CurrentVersion;
+    header.trainCount = static_cast<uint32_t>(trains.size());
+    header.typeCount = static_cast<uint32_t>(VanTypeCount);
+    header.fileSize = sizeof(SnapshotHeader) + trains.size() * sizeof(uint64_t);
+    for (const Train* train : trains)
+        header.fileSize += SectionSize(train->GetSize());
+    Checksum checksum;
+    EmitBody(trains, [&](const void* data, size_t length) { checksum.Add(data, length); });
+    header.checksum = checksum.Value();
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    EmitBody(trains, [&](const void* data, size_t length) { os.write(static_cast<const char*>(data), static_cast<std::streamsize>(length)); });
+    if (!os)
+        throw std::runtime_error("Error: Failed to write snapshot.");
+}
+
+void WriteSnapshot(const std::string& path, std::span<const Train* const> trains) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Error: Cannot open " + path + " for writing.");
+    WriteSnapshot(file, trains);
+    file.close();
+    if (!file)
+        throw std::runtime_error("Error: Failed to write snapshot.");
+}
+
+void WriteSnapshot(const std::string& path, const Train& train) {
+    const Train* trains[] = {&train};
+    WriteSnapshot(path, trains);
+}
+
+OccupancyStats TrainView::StaffingPercentage() const noexcept {
+    OccupancyStats stats;
+    if (!header_)
+        return stats;
+    stats.seatingVans = header_->seatingVans;
+    for (size_t t = 0; t < VanTypeCount; ++t)
+        stats.types[t] = {header_->vans[t], header_->capacity[t], header_->occupied[t]};
+    return stats;
+}
+
+Train TrainView::ToTrain() const {
+    Train train;
+    train.Reserve(GetSize());
+    for (size_t i = 0; i < GetSize(); ++i)
+        train += Van(capacities_[i], occupied_[i], types_[i]);
+    return train;
+}
+
+Snapshot::Snapshot(Snapshot&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)), trainCount_(std::exchange(other.trainCount_, 0)) {}
+
+Snapshot& Snapshot::operator=(Snapshot&& other) noexcept {
+    if (this != &other) {
+        if (data_)
+            munmap(data_, size_);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        trainCount_ = std::exchange(other.trainCount_, 0);
+    }
+    return *this;
+}
+
+Snapshot::~Snapshot() {
+    if (data_)
+        munmap(data_, size_);
+}
+
+Snapshot Snapshot::Open(const std::string& path, bool verifyChecksum) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Error: Cannot open " + path + ".");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Error: Cannot stat " + path + ".");
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size < sizeof(SnapshotHeader)) {
+        close(fd);
+        throw std::invalid_argument("Error: " + path + " is too short to be a snapshot.");
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Error: Cannot map " + path + ".");
+    Snapshot snapshot(data, size);
+    snapshot.Validate(verifyChecksum);
+    return snapshot;
+}
+
+void Snapshot::Validate(bool verifyChecksum) {
+    const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(data_);
+    if (std::memcmp(header.magic, SnapshotHeader::Magic, sizeof(header.magic)) != 0)
+        throw std::invalid_argument("Error: Not a train snapshot.");
+    if (header.version != SnapshotHeader::CurrentVersion)
+        throw std::invalid_argument("Error: Unsupported snapshot version.");
+    if (header.typeCount != VanTypeCount)
+        throw std::invalid_argument("Error: Snapshot was written with a different set of van types.");
+    if (header.fileSize != size_ || (size_ - sizeof(SnapshotHeader)) % 8 != 0
+        || header.trainCount > (size_ - sizeof(SnapshotHeader)) / sizeof(uint64_t))
+        throw std::invalid_argument("Error: Snapshot size does not match its header.");
+    if (verifyChecksum) {
+        Checksum checksum;
+        checksum.Add(Bytes() + sizeof(SnapshotHeader), size_ - sizeof(SnapshotHeader));
+        if (checksum.Value() != header.checksum)
+            throw std::invalid_argument("Error: Snapshot checksum mismatch.");
+    }
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(Bytes() + sizeof(SnapshotHeader));
+    for (uint32_t i = 0; i < header.trainCount; ++i) {
+        uint64_t offset = offsets[i];
+        if (offset % 8 != 0 || offset > size_ || size_ - offset < sizeof(SnapshotTrainHeader))
+            throw std::invalid_argument("Error: Snapshot train offset out of range.");
+        uint64_t vanCount = reinterpret_cast<const SnapshotTrainHeader*>(Bytes() + offset)->vanCount;
+        if (vanCount > size_ || SectionSize(vanCount) > size_ - offset)
+            throw std::invalid_argument("Error: Snapshot train section out of range.");
+        if (verifyChecksum) {
+            const uint32_t* types = reinterpret_cast<const uint32_t*>(Bytes() + offset + sizeof(SnapshotTrainHeader) + 2 * vanCount * sizeof(uint64_t));
+            for (uint64_t j = 0; j < vanCount; ++j) {
+                if (types[j] >= VanTypeCount)
+                    throw std::invalid_argument("Error: Snapshot holds an unknown van type.");
+            }
+        }
+    }
+    trainCount_ = header.trainCount;
+}
+
+TrainView Snapshot::operator[](size_t index) const {
+    if (index >= trainCount_)
+        throw std::out_of_range("Index out of snapshot range");
+    uint64_t offset = reinterpret_cast<const uint64_t*>(Bytes() + sizeof(SnapshotHeader))[index];
+    TrainView view;
+    view.header_ = reinterpret_cast<const SnapshotTrainHeader*>(Bytes() + offset);
+    size_t count = view.header_->vanCount;
+    view.capacities_ = reinterpret_cast<const size_t*>(view.header_ + 1);
+    view.occupied_ = view.capacities_ + count;
+    view.types_ = reinterpret_cast<const VanType*>(view.occupied_ + count);
+    return view;
+}
+
+} // namespace mgt
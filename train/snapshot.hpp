@@ -0,0 +1,131 @@
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+#include "../van/van.hpp"
+#include "occupancy_stats.hpp"
+#include "train.hpp"
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+
+namespace mgt {
+
+// Binary snapshot of one or more trains, little-endian throughout:
+//
+//   SnapshotHeader
+//   uint64_t offsets[trainCount]            byte offset of each train section
+//   per train, 8-byte aligned:
+//     SnapshotTrainHeader
+//     uint64_t capacities[vanCount]
+//     uint64_t occupied[vanCount]
+//     uint32_t types[vanCount]              padded to a multiple of 8 bytes
+//
+// The columns have the same layout as Train's in memory, so a mapped file is queried
+// in place. The checksum covers every byte after the header.
+struct SnapshotHeader {
+    static constexpr char Magic[8] = {'M', 'G', 'T', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr uint32_t CurrentVersion = 2;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t trainCount;
+    uint64_t fileSize;
+    uint64_t checksum;
+    uint32_t typeCount; // VanTypeCount of the writer: it sizes SnapshotTrainHeader
+    uint32_t reserved[7];
+};
+
+struct SnapshotTrainHeader {
+    uint64_t vanCount;
+    uint64_t seatingVans;
+    uint64_t vans[VanTypeCount];
+    uint64_t capacity[VanTypeCount];
+    uint64_t occupied[VanTypeCount];
+};
+
+static_assert(sizeof(SnapshotHeader) == 64 && sizeof(SnapshotTrainHeader) % 8 == 0);
+
+// Writes the trains as one snapshot. Throws std::runtime_error if the stream fails.
+void WriteSnapshot(std::ostream& os, std::span<const Train* const> trains);
+void WriteSnapshot(const std::string& path, std::span<const Train* const> trains);
+void WriteSnapshot(const std::string& path, const Train& train);
+
+// Read-only train backed by snapshot memory. Offers the const query API of Train;
+// valid as long as the Snapshot it came from.
+class TrainView {
+private:
+    const SnapshotTrainHeader* header_ = nullptr;
+    const size_t* capacities_ = nullptr;
+    const size_t* occupied_ = nullptr;
+    const VanType* types_ = nullptr;
+
+    friend class Snapshot;
+
+public:
+    TrainView() = default;
+
+    size_t GetSize() const noexcept { return header_ ? header_->vanCount : 0; }
+
+    Van operator[](size_t index) const {
+        if (index >= GetSize())
+            throw std::out_of_range("Index out of train range");
+        return Van(capacities_[index], occupied_[index], types_[index]);
+    }
+
+    // Stored with the snapshot, so this is O(1) like Train::StaffingPercentage.
+    [[nodiscard]] OccupancyStats StaffingPercentage() const noexcept;
+
+    void OccupancyRates(size_t* rates) const noexcept {
+        ComputeOccupancyRates(capacities_, occupied_, GetSize(), rates);
+    }
+
+    // Same choice as Train::FindBestFit; a linear scan, since the view holds no index.
+    [[nodiscard]] size_t FindBestFit(size_t numOfPassengers) const noexcept {
+        size_t best = FindLeastOccupied(capacities_, occupied_, GetSize(), numOfPassengers);
+        return best == GetSize() ? Train::NotSeated : best;
+    }
+
+    [[nodiscard]] std::span<const size_t> Capacities() const noexcept { return {capacities_, GetSize()}; }
+    [[nodiscard]] std::span<const size_t> OccupiedSeats() const noexcept { return {occupied_, GetSize()}; }
+    [[nodiscard]] std::span<const VanType> Types() const noexcept { return {types_, GetSize()}; }
+
+    // Copies the vans into a mutable Train.
+    [[nodiscard]] Train ToTrain() const;
+};
+
+// A snapshot file mapped into memory with mmap. Move-only; unmaps on destruction.
+class Snapshot {
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    uint32_t trainCount_ = 0;
+
+    Snapshot(void* data, size_t size) noexcept : data_(data), size_(size) {}
+
+    [[nodiscard]] const unsigned char* Bytes() const noexcept { return static_cast<const unsigned char*>(data_); }
+
+    void Validate(bool verifyChecksum);
+
+public:
+    Snapshot() noexcept = default;
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    Snapshot(Snapshot&& other) noexcept;
+    Snapshot& operator=(Snapshot&& other) noexcept;
+    ~Snapshot();
+
+    // Maps `path`. Throws std::runtime_error if the file cannot be mapped and
+    // std::invalid_argument if it is not a well-formed snapshot. Verification checks the
+    // checksum and every van type, reading the whole file; skip it when the file is
+    // trusted and start-up time matters.
+    static Snapshot Open(const std::string& path, bool verifyChecksum = true);
+
+    size_t GetTrainCount() const noexcept { return trainCount_; }
+
+    TrainView operator[](size_t index) const;
+};
+
+} // namespace mgt
+
+#endif
@@ -0,0 +1,118 @@
+#include "thread_pool.hpp"
+
+namespace mgt {
+
+ThreadPool::ThreadPool(size_t threads) : queues_(new Queue[std::max<size_t>(threads, 1)]) {
+    try {
+        workers_.reserve(threads);
+        for (size_t i = 1; i < threads; ++i)
+            workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    } catch (...) {
+        // The destructor does not run for a half-built pool, and a joinable std::thread
+        // must not be destroyed.
+        Stop();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() { Stop(); }
+
+void ThreadPool::Stop() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0)
+        return;
+    Job job;
+    job.body = &body;
+    job.remaining.store(count, std::memory_order_relaxed);
+    size_t threads = GetThreadCount();
+    for (size_t t = 0; t < threads; ++t) {
+        std::lock_guard<std::mutex> lock(queues_[t].mutex);
+        for (size_t i = count * t / threads; i < count * (t + 1) / threads; ++i)
+            queues_[t].tasks.push_back({&job, i});
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+    }
+    wake_.notify_all();
+    Drain(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return job.remaining.load(std::memory_order_acquire) == 0; });
+    }
+    if (job.error)
+        std::rethrow_exception(job.error);
+}
+
+void ThreadPool::WorkerLoop(size_t self) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_)
+                return;
+            seen = generation_;
+        }
+        Drain(self);
+    }
+}
+
+// Tasks are only queued before a job starts, so once every queue is empty this thread
+// has nothing left to do for it.
+void ThreadPool::Drain(size_t self) {
+    Task task;
+    while (Pop(self, task) || Steal(self, task))
+        Execute(task);
+}
+
+bool ThreadPool::Pop(size_t self, Task& task) {
+    Queue& queue = queues_[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+        return false;
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::Steal(size_t self, Task& task) {
+    size_t threads = GetThreadCount();
+    for (size_t offset = 1; offset < threads; ++offset) {
+        Queue& victim = queues_[(self + offset) % threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Execute(const Task& task) {
+    Job& job = *task.job;
+    try {
+        (*job.body)(task.index);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(job.errorMutex);
+        if (!job.error)
+            job.error = std::current_exception();
+    }
+    // The caller may return as soon as it sees zero, so this is the last touch of job.
+    if (job.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+    }
+}
+
+} // namespace mgt
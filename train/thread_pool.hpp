@@ -0,0 +1,72 @@
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mgt {
+
+// Fixed set of worker threads for data-parallel loops. Each ParallelFor deals its tasks
+// out to per-thread queues in contiguous runs; a thread works through its own queue
+// from the front and, once that is empty, steals from the back of the others.
+class ThreadPool {
+public:
+    // `threads` counts the calling thread, which always takes part in ParallelFor.
+    explicit ThreadPool(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency()));
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    size_t GetThreadCount() const noexcept { return workers_.size() + 1; }
+
+    // Runs body(i) once for every i in [0, count) and returns when all calls have
+    // finished. The first exception thrown by body is rethrown here. Not reentrant:
+    // body must not call ParallelFor on the same pool.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* body;
+        std::atomic<size_t> remaining;
+        std::exception_ptr error;
+        std::mutex errorMutex;
+    };
+
+    struct Task {
+        Job* job;
+        size_t index;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<Queue[]> queues_; // queues_[0] belongs to the calling thread
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    size_t generation_ = 0;
+    bool stopping_ = false;
+
+    void Stop() noexcept;
+    void WorkerLoop(size_t self);
+    void Drain(size_t self);
+    bool Pop(size_t self, Task& task);
+    bool Steal(size_t self, Task& task);
+    void Execute(const Task& task);
+};
+
+} // namespace mgt
+
+#endif
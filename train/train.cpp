@@ -1,108 +1,451 @@
 #include "train.hpp"
+#include "manifest.hpp"
+#include "thread_pool.hpp"
 #include <algorithm>
+#include <bit>
+#include <functional>
+#include <thread>
 
 namespace mgt {
 
+namespace {
+
+// Per-van loops of the pool overloads run in chunks of at least this many vans.
+const size_t CHUNK_VANS = 1 << 14;
+
+// Without a pool a loop is one chunk, so the serial overloads run exactly as before.
+size_t ChunkCount(const ThreadPool* pool, size_t count) noexcept {
+    return pool && pool->GetThreadCount() > 1 ? std::max<size_t>(1, count / CHUNK_VANS) : 1;
+}
+
+// Calls body(chunk, first, last) for `chunks` even slices of [0, count), on pool if there
+// is more than one.
+template <typename Body>
+void ForChunks(ThreadPool* pool, size_t count, size_t chunks, Body body) {
+    if (chunks == 1) {
+        body(size_t{0}, size_t{0}, count);
+        return;
+    }
+    pool->ParallelFor(chunks, [&](size_t chunk) { body(chunk, count * chunk / chunks, count * (chunk + 1) / chunks); });
+}
+
+} // namespace
+
+void Train::RecountTotals(ThreadPool* pool) {
+    size_t chunks = ChunkCount(pool, size_);
+    if (chunks == 1) {
+        RecountTotals();
+        return;
+    }
+    // Every partial result is an integer sum, so adding them up in chunk order gives
+    // exactly the serial totals.
+    std::vector<OccupancyStats> stats(chunks);
+    std::vector<uint64_t> hashes(chunks);
+    ForChunks(pool, size_, chunks, [&](size_t chunk, size_t first, size_t last) {
+        stats[chunk] = SumOccupancy(capacities_ + first, occupied_ + first, types_ + first, last - first);
+        uint64_t hash = 0;
+        for (size_t i = first; i < last; ++i)
+            hash += VanHash(i);
+        hashes[chunk] = hash;
+    });
+    totals_ = {};
+    hash_ = 0;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        totals_ += stats[chunk];
+        hash_ += hashes[chunk];
+    }
+}
+
+void Train::RebuildIndexes() {
+    if (seatIndex_)
+        *seatIndex_ = SeatIndex(capacities_, occupied_, size_);
+    if (placementIndex_) {
+        placementIndex_->passengers.Assign(size_, [this](size_t i) { return PlacementWeight(i); });
+        placementIndex_->restaurants.Assign(size_, [this](size_t i) { return static_cast<size_t>(types_[i] == VanType::Restaurant); });
+    }
+}
+
+void Train::FinishBulkChange(ThreadPool* pool) {
+    RecountTotals(pool);
+    RebuildIndexes();
+    if (capacity_ > InlineVans && size_ <= capacity_ / 4)
+        Resize(size_ * 2);
+}
+
+std::expected<void, VanError> Train::TryEraseRange(size_t first, size_t last) {
+    if (first > last || last > size_)
+        return std::unexpected(VanError::IndexOutOfRange);
+    if (first == last)
+        return {};
+    std::copy(capacities_ + last, capacities_ + size_, capacities_ + first);
+    std::copy(occupied_ + last, occupied_ + size_, occupied_ + first);
+    std::copy(types_ + last, types_ + size_, types_ + first);
+    size_ -= last - first;
+    FinishBulkChange();
+    return {};
+}
+
+std::expected<void, VanError> Train::TryInsertAt(size_t pos, std::span<const Van> vans) {
+    if (pos > size_)
+        return std::unexpected(VanError::IndexOutOfRange);
+    if (vans.empty())
+        return {};
+    size_t count = vans.size(), tail = size_ - pos;
+    if (size_ + count > capacity_) {
+        // Lay the columns out afresh in the new block so each van is copied only once.
+        size_t storage = StorageFor(std::max(size_ + count, capacity_ * 2));
+        size_t* block = Allocate(storage);
+        size_t* capacities = block;
+        size_t* occupied = block + storage;
+        VanType* types = reinterpret_cast<VanType*>(block + 2 * storage);
+        std::copy_n(capacities_, pos, capacities);
+        std::copy_n(occupied_, pos, occupied);
+        std::copy_n(types_, pos, types);
+        std::copy_n(capacities_ + pos, tail, capacities + pos + count);
+        std::copy_n(occupied_ + pos, tail, occupied + pos + count);
+        std::copy_n(types_ + pos, tail, types + pos + count);
+        Release();
+        Adopt(block, storage);
+    } else {
+        std::copy_backward(capacities_ + pos, capacities_ + size_, capacities_ + size_ + count);
+        std::copy_backward(occupied_ + pos, occupied_ + size_, occupied_ + size_ + count);
+        std::copy_backward(types_ + pos, types_ + size_, types_ + size_ + count);
+    }
+    for (size_t i = 0; i < count; ++i)
+        Store(pos + i, vans[i]);
+    size_ += count;
+    FinishBulkChange();
+    return {};
+}
+
+void Train::MoveVan(size_t from, size_t to) {
+    if (from == to)
+        return;
+    size_t lo = std::min(from, to), hi = std::max(from, to) + 1;
+    // Point updates cost O(log n) per shifted van; past about n / log n vans a rebuild is cheaper.
+    size_t logSize = 1;
+    while ((size_t{1} << logSize) < size_)
+        ++logSize;
+    bool rebuild = (hi - lo) * logSize > size_;
+    for (size_t i = lo; i < hi; ++i)
+        hash_ -= VanHash(i);
+    for (size_t i = lo; i < hi && !rebuild; ++i) {
+        if (seatIndex_)
+            seatIndex_->Erase(i, capacities_[i], occupied_[i]);
+        Unplace(i);
+    }
+    size_t first = from < to ? from : to, middle = from < to ? from + 1 : from, last = from < to ? to + 1 : from + 1;
+    std::rotate(capacities_ + first, capacities_ + middle, capacities_ + last);
+    std::rotate(occupied_ + first, occupied_ + middle, occupied_ + last);
+    std::rotate(types_ + first, types_ + middle, types_ + last);
+    for (size_t i = lo; i < hi; ++i)
+        hash_ += VanHash(i);
+    if (rebuild) {
+        RebuildIndexes();
+        return;
+    }
+    for (size_t i = lo; i < hi; ++i) {
+        if (seatIndex_)
+            seatIndex_->Insert(i, capacities_[i], occupied_[i]);
+        Place(i);
+    }
+}
+
 Train& Train::operator=(const Train& other) {
     if (this != &other) {
-        if (other.capacity_ != capacity_) {
-            Van* temp = new Van[other.capacity_];
-            delete[] vans_;
-            vans_ = temp;
-            capacity_ = other.capacity_;
+        if (other.size_ > capacity_) {
+            size_t* block = Allocate(StorageFor(other.size_));
+            Release();
+            Adopt(block, StorageFor(other.size_));
         }
         size_ = other.size_;
-        std::copy_n(other.vans_, size_, vans_);
+        CopyColumns(other);
+        totals_ = other.totals_;
+        hash_ = other.hash_;
+        seatIndex_ = other.seatIndex_ ? std::make_unique<SeatIndex>(*other.seatIndex_) : nullptr;
+        placementIndex_ = other.placementIndex_ ? std::make_unique<PlacementIndex>(*other.placementIndex_) : nullptr;
     }
     return *this;
 }
 
 Train& Train::operator=(Train&& other) noexcept {
     if (this != &other) {
-        delete[] vans_;
-        vans_ = other.vans_;
-        size_ = other.size_;
-        capacity_ = other.capacity_;
-        other.vans_ = nullptr;
-        other.size_ = 0;
-        other.capacity_ = 0;
+        if (other.IsInline()) {
+            // Our own storage always holds InlineVans, so the columns just get copied over.
+            size_ = other.size_;
+            CopyColumns(other);
+        } else {
+            Release();
+            resource_ = other.resource_;
+            Adopt(other.capacities_, other.capacity_);
+            size_ = other.size_;
+        }
+        seatIndex_ = std::move(other.seatIndex_);
+        placementIndex_ = std::move(other.placementIndex_);
+        totals_ = other.totals_;
+        hash_ = other.hash_;
+        other.Reset();
     }
     return *this;
 }
 
-void Train::SitInMin(size_t numOfPassengers) {
-    Van* minOccupiedVan = nullptr;
-    size_t minOccupiedSeats = 0;
-    
-    for (size_t i = 0; i < size_; ++i) {
-        size_t availableSeats = vans_[i].GetCapacity() - vans_[i].GetOccupiedSeats();
-        if (numOfPassengers <= availableSeats && (!minOccupiedVan || vans_[i].GetOccupiedSeats() < minOccupiedSeats)) {
-            minOccupiedSeats = vans_[i].GetOccupiedSeats();
-            minOccupiedVan = &vans_[i];
+void Train::Write(std::ostream& os) const noexcept {
+    char buffer[4096];
+    ManifestWriter writer(*this);
+    while (size_t length = writer.Write(buffer))
+        os.write(buffer, static_cast<std::streamsize>(length));
+}
+
+void Train::Read(std::istream& is) noexcept {
+    Train temp(resource_);
+    try {
+        if ((is >> std::ws).peek() == '{') {
+            // Feed the parser up to the closing '}' a buffer at a time, leaving whatever
+            // follows the manifest in the stream.
+            char buffer[4096];
+            ManifestParser parser(temp);
+            ParseStatus status;
+            while (status) {
+                is.get(buffer, sizeof(buffer), '}');
+                size_t length = static_cast<size_t>(is.gcount());
+                if (length == 0 && !is.eof())
+                    is.clear(is.rdstate() & ~std::istream::failbit); // '}' came first
+                status = parser.Feed(std::string_view(buffer, length));
+                if (!status || !is || is.eof())
+                    break;
+                if (is.peek() == '}') {
+                    is.ignore();
+                    status = parser.Feed("}");
+                    break;
+                }
+            }
+            if (status)
+                status = parser.Finish();
+            if (!status) {
+                is.setstate(std::istream::failbit);
+                return;
+            }
+        } else {
+            Van van;
+            if (!(is >> van))
+                return;
+            temp += van;
         }
+    } catch (const std::exception&) {
+        is.setstate(std::istream::failbit);
+        return;
     }
-    
-    if (minOccupiedVan) {
-        *minOccupiedVan += numOfPassengers;
-    }
+    bool seatIndexed = HasSeatIndex(), placementIndexed = HasPlacementIndex();
+    *this = std::move(temp);
+    if (seatIndexed)
+        EnableSeatIndex();
+    if (placementIndexed)
+        EnablePlacementIndex();
 }
 
-void Train::StaffingPercentage() noexcept {
-    struct VanStats {
-        size_t totalCapacity = 0;
-        size_t totalOccupied = 0;
-    };
-    
-    std::map<VanType, VanStats> stats = {
-        {VanType::Restaurant, {}},
-        {VanType::Seated, {}},
-        {VanType::Economy, {}},
-        {VanType::Luxury, {}}
-    };
-    
-    for (size_t i = 0; i < size_; ++i) {
-        VanStats& stat = stats[vans_[i].GetType()];
-        stat.totalCapacity += vans_[i].GetCapacity();
-        stat.totalOccupied += vans_[i].GetOccupiedSeats();
+size_t Train::FindBestFit(size_t numOfPassengers) const noexcept {
+    if (seatIndex_)
+        return seatIndex_->FindBestFit(numOfPassengers);
+    size_t best = FindLeastOccupied(capacities_, occupied_, size_, numOfPassengers);
+    return best == size_ ? NotSeated : best;
+}
+
+size_t Train::SitInMin(size_t numOfPassengers) {
+    size_t best = FindBestFit(numOfPassengers);
+    if (best != NotSeated)
+        SetOccupied(best, occupied_[best] + numOfPassengers);
+    return best;
+}
+
+std::vector<size_t> Train::SitInMinBatch(std::span<const size_t> groups) {
+    // Below this many groups building a throwaway index costs more than rescanning.
+    const size_t MIN_INDEXED_BATCH = 8;
+    std::vector<size_t> placed(groups.size(), NotSeated);
+    if (seatIndex_ || groups.size() < MIN_INDEXED_BATCH) {
+        for (size_t i = 0; i < groups.size(); ++i)
+            placed[i] = SitInMin(groups[i]);
+        return placed;
     }
+    SeatIndex index(capacities_, occupied_, size_);
+    for (size_t i = 0; i < groups.size(); ++i) {
+        size_t best = index.FindBestFit(groups[i]);
+        if (best == NotSeated)
+            continue;
+        index.Update(best, capacities_[best], occupied_[best], capacities_[best], occupied_[best] + groups[i]);
+        hash_ -= VanHash(best);
+        occupied_[best] += groups[i];
+        hash_ += VanHash(best);
+        totals_.types[static_cast<size_t>(types_[best])].occupied += groups[i];
+        if (placementIndex_ && types_[best] != VanType::Luxury)
+            placementIndex_->passengers.Add(best, groups[i]);
+        placed[i] = best;
+    }
+    return placed;
 }
 
-void Train::BalanceOccupancy() {
-    size_t count = 0, totalOccupancy = 0, totalCapacity = 0;
-    for (size_t i = 0; i < size_; ++i) {
-        if (vans_[i].GetCapacity() > 0) {
-            ++count;
-            totalOccupancy += vans_[i].GetOccupiedSeats();
-            totalCapacity += vans_[i].GetCapacity();
+namespace {
+
+// Uninitialized array of trivially copyable scratch values, returned to its resource on scope exit.
+template <typename T>
+class ScratchArray {
+public:
+    ScratchArray(std::pmr::memory_resource* resource, size_t count)
+        : resource_(resource), count_(count), data_(static_cast<T*>(resource->allocate(count * sizeof(T), alignof(T)))) {}
+    ScratchArray(const ScratchArray&) = delete;
+    ScratchArray& operator=(const ScratchArray&) = delete;
+    ~ScratchArray() { resource_->deallocate(data_, count_ * sizeof(T), alignof(T)); }
+
+    [[nodiscard]] T* Get() const noexcept { return data_; }
+
+private:
+    std::pmr::memory_resource* resource_;
+    size_t count_;
+    T* data_;
+};
+
+struct Assignment {
+    size_t index;
+    size_t baseOccupancy;
+    double fraction;
+    size_t capacity;
+};
+
+bool ByFraction(const Assignment& a, const Assignment& b) noexcept {
+    return a.fraction > b.fraction;
+}
+
+// Puts the assignments in exactly the order the original recursive Lomuto quicksort left
+// them in, equal fractions included, since that order decides which of several tied
+// vans get the leftover passengers. Runs iteratively, and a run of pivots equal to the
+// largest fraction in their range, which cost that quicksort a full scan each, is
+// placed in one pass: O(n) per distinct fraction instead of O(n) per van.
+// That quicksort is still quadratic on input that is already in or against fraction
+// order, so the emulation gives up once it has scanned several times what a random
+// input would need, and returns false with the array in no particular order.
+bool QuicksortOrder(Assignment* arr, size_t count, std::pmr::memory_resource* scratch) {
+    const size_t WORK_PER_LEVEL = 2;
+    size_t budget = WORK_PER_LEVEL * count * (std::bit_width(count) + 1);
+    std::pmr::vector<std::pair<size_t, size_t>> ranges(scratch);
+    if (count > 1)
+        ranges.emplace_back(0, count - 1);
+    while (!ranges.empty()) {
+        auto [low, high] = ranges.back();
+        ranges.pop_back();
+        if (high - low + 1 > budget)
+            return false;
+        budget -= high - low + 1;
+        double pivot = arr[high].fraction;
+        bool pivotIsMax = std::none_of(arr + low, arr + high, [pivot](const Assignment& a) { return a.fraction > pivot; });
+        if (pivotIsMax) {
+            // With nothing above the pivot each partition swaps the range's first element
+            // with the pivot and carries on one place further, so the leading vans that
+            // equal the pivot come to rest in order behind it.
+            size_t ties = 0;
+            while (low + ties < high && arr[low + ties].fraction == pivot)
+                ++ties;
+            std::rotate(arr + low, arr + high, arr + high + 1);
+            if (low + ties < high) {
+                std::rotate(arr + low + ties + 1, arr + low + ties + 2, arr + high + 1);
+                if (low + ties + 1 < high)
+                    ranges.emplace_back(low + ties + 1, high);
+            }
+            continue;
+        }
+        size_t i = low;
+        for (size_t j = low; j < high; ++j) {
+            if (arr[j].fraction > pivot)
+                std::swap(arr[i++], arr[j]);
         }
+        std::swap(arr[i], arr[high]);
+        if (i > low + 1)
+            ranges.emplace_back(low, i - 1);
+        if (i + 1 < high)
+            ranges.emplace_back(i + 1, high);
     }
+    return true;
+}
+
+} // namespace
+
+void Train::BalanceOccupancy(std::pmr::memory_resource* scratch) { BalanceOccupancy(scratch, nullptr); }
+
+void Train::BalanceOccupancy(ThreadPool& pool) { BalanceOccupancy(std::pmr::get_default_resource(), &pool); }
+
+void Train::BalanceOccupancy(std::pmr::memory_resource* scratch, ThreadPool* pool) {
+    size_t count = totals_.seatingVans, totalOccupancy = totals_.TotalOccupied(), totalCapacity = totals_.TotalCapacity();
     if (totalCapacity == 0 || count == 0)
         return;
     double targetRatio = static_cast<double>(totalOccupancy) / totalCapacity;
-    Assignment* assignments = new Assignment[count];
-    size_t j = 0, sumBase = 0;
-    for (size_t i = 0; i < size_; ++i) {
-        if (vans_[i].GetCapacity() > 0) {
-            size_t cap = vans_[i].GetCapacity();
-            double ideal = targetRatio * cap;
-            size_t baseOcc = static_cast<size_t>(ideal);
-            double frac = ideal - baseOcc;
-            sumBase += baseOcc;
-            assignments[j].index = i;
-            assignments[j].baseOccupancy = baseOcc;
-            assignments[j].fraction = frac;
-            assignments[j].capacity = cap;
-            ++j;
-        }
+    ScratchArray<Assignment> buffer(scratch, count);
+    Assignment* assignments = buffer.Get();
+    // Each chunk of vans fills its own slice of assignments, starting after the seating
+    // vans of the chunks before it.
+    size_t chunks = ChunkCount(pool, size_);
+    ScratchArray<size_t> offsetBuffer(scratch, chunks), baseBuffer(scratch, chunks);
+    size_t* offsets = offsetBuffer.Get();
+    size_t* chunkBase = baseBuffer.Get();
+    offsets[0] = 0;
+    if (chunks > 1) {
+        ForChunks(pool, size_, chunks, [&](size_t chunk, size_t first, size_t last) {
+            chunkBase[chunk] = CountSeating(capacities_ + first, last - first);
+        });
+        for (size_t chunk = 1; chunk < chunks; ++chunk)
+            offsets[chunk] = offsets[chunk - 1] + chunkBase[chunk - 1];
     }
+    size_t sumBase = 0;
+    auto fill = [&] {
+        ForChunks(pool, size_, chunks, [&](size_t chunk, size_t first, size_t last) {
+            size_t j = offsets[chunk], base = 0;
+            for (size_t i = first; i < last; ++i) {
+                if (capacities_[i] > 0) {
+                    size_t cap = capacities_[i];
+                    double ideal = targetRatio * cap;
+                    size_t baseOcc = static_cast<size_t>(ideal);
+                    double frac = ideal - baseOcc;
+                    base += baseOcc;
+                    assignments[j].index = i;
+                    assignments[j].baseOccupancy = baseOcc;
+                    assignments[j].fraction = frac;
+                    assignments[j].capacity = cap;
+                    ++j;
+                }
+            }
+            chunkBase[chunk] = base;
+        });
+        sumBase = 0;
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+            sumBase += chunkBase[chunk];
+    };
+    fill();
     size_t remainder = totalOccupancy - sumBase;
-    quickSortAssignments(assignments, 0, count - 1);
+    // Only vans below capacity can take a leftover passenger, and only the `remainder`
+    // largest fractions among them do, so a selection is enough as long as no tie
+    // straddles the cut. Otherwise the old quicksort's order among the tied vans decides.
+    Assignment* full = std::partition(assignments, assignments + count,
+                                      [](const Assignment& a) { return a.baseOccupancy < a.capacity; });
+    size_t open = static_cast<size_t>(full - assignments);
+    bool exact = remainder > open;
+    if (remainder > 0 && remainder < open) {
+        std::nth_element(assignments, assignments + remainder, full, ByFraction);
+        double cut = std::min_element(assignments, assignments + remainder,
+                                      [](const Assignment& a, const Assignment& b) { return a.fraction < b.fraction; })->fraction;
+        exact = std::any_of(assignments + remainder, full, [cut](const Assignment& a) { return a.fraction == cut; });
+    }
+    if (exact) {
+        fill();
+        if (!QuicksortOrder(assignments, count, scratch)) {
+            // Too costly to reproduce: ties fall back to van order instead.
+            fill();
+            std::stable_sort(assignments, assignments + count, ByFraction);
+        }
+    }
     for (size_t i = 0; i < count && remainder > 0; ++i) {
         if (assignments[i].baseOccupancy < assignments[i].capacity) {
             assignments[i].baseOccupancy++;
             remainder--;
         }
     }
+    // Rounding can leave more seats than open vans; keep handing them out in fraction order.
     while (remainder > 0) {
         bool assignedAny = false;
         for (size_t i = 0; i < count && remainder > 0; ++i) {
@@ -115,143 +458,275 @@ void Train::BalanceOccupancy() {
         if (!assignedAny)
             break;
     }
-    for (size_t i = 0; i < count; ++i)
-        vans_[assignments[i].index].SetOccupiedSeats(assignments[i].baseOccupancy);
-    delete[] assignments;
+    ForChunks(pool, count, ChunkCount(pool, count), [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            occupied_[assignments[i].index] = assignments[i].baseOccupancy;
+    });
+    RecountTotals(pool);
+    RebuildIndexes();
 }
 
-void Train::MinimizeVans() {
-    struct VanInfo { size_t capacity; size_t occupied; };
-    const size_t NUM_TYPES = 4;
-    VanType types[NUM_TYPES] = {VanType::Restaurant, VanType::Seated, VanType::Economy, VanType::Luxury};
-    struct Group { size_t count; size_t totalOccupancy; VanInfo* infos; } groups[NUM_TYPES];
-    for (size_t i = 0; i < NUM_TYPES; ++i) {
-        groups[i].count = 0;
-        groups[i].totalOccupancy = 0;
-        groups[i].infos = nullptr;
+namespace {
+
+// Sorts a capacity column in descending order. Seat counts are small, so they are
+// usually counting-sorted; anything larger goes through std::sort.
+void SortCapacitiesDescending(size_t* capacities, size_t count) noexcept {
+    const size_t COUNTING_SORT_LIMIT = 1024;
+    if (count < 2)
+        return;
+    size_t maxCapacity = *std::max_element(capacities, capacities + count);
+    if (maxCapacity > COUNTING_SORT_LIMIT) {
+        std::sort(capacities, capacities + count, std::greater<size_t>());
+        return;
     }
-    for (size_t i = 0; i < size_; ++i) {
-        VanType t = vans_[i].GetType();
-        for (size_t j = 0; j < NUM_TYPES; ++j) {
-            if (types[j] == t) {
-                groups[j].count++;
-                groups[j].totalOccupancy += vans_[i].GetOccupiedSeats();
-                break;
-            }
-        }
+    size_t counts[COUNTING_SORT_LIMIT + 1] = {};
+    for (size_t i = 0; i < count; ++i)
+        ++counts[capacities[i]];
+    size_t pos = 0;
+    for (size_t capacity = maxCapacity + 1; capacity-- > 0;) {
+        std::fill_n(capacities + pos, counts[capacity], capacity);
+        pos += counts[capacity];
     }
-    for (size_t i = 0; i < NUM_TYPES; ++i) {
-        if (groups[i].count > 0) {
-            groups[i].infos = new VanInfo[groups[i].count];
-            groups[i].count = 0;
-        }
+}
+
+// Packs totalOccupancy passengers into the largest vans of one type group and
+// returns how many vans are needed; those end up at the front of the group.
+size_t PackGroup(size_t* capacities, size_t* occupied, size_t count, size_t totalOccupancy) noexcept {
+    SortCapacitiesDescending(capacities, count);
+    size_t required = 0, capSum = 0;
+    while (required < count && capSum < totalOccupancy)
+        capSum += capacities[required++];
+    size_t remaining = totalOccupancy;
+    for (size_t a = 0; a < required; ++a) {
+        occupied[a] = std::min(remaining, capacities[a]);
+        remaining -= occupied[a];
     }
-    for (size_t i = 0; i < size_; ++i) {
-        VanType t = vans_[i].GetType();
-        for (size_t j = 0; j < NUM_TYPES; ++j) {
-            if (types[j] == t && groups[j].infos) {
-                groups[j].infos[groups[j].count].capacity = vans_[i].GetCapacity();
-                groups[j].infos[groups[j].count].occupied = vans_[i].GetOccupiedSeats();
-                groups[j].count++;
-                break;
+    return required;
+}
+
+} // namespace
+
+void Train::MinimizeVans(size_t threads) { MinimizeVans(threads, nullptr); }
+
+void Train::MinimizeVans(ThreadPool& pool) { MinimizeVans(pool.GetThreadCount(), &pool); }
+
+void Train::MinimizeVans(size_t threads, ThreadPool* pool) {
+    // Type groups are independent, so large trains pack them on separate threads.
+    const size_t PARALLEL_THRESHOLD = 1 << 15;
+    size_t count[VanTypeCount], totalOccupancy[VanTypeCount];
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        count[t] = totals_.types[t].vans;
+        totalOccupancy[t] = totals_.types[t].occupied;
+    }
+    size_t start[VanTypeCount], next[VanTypeCount];
+    for (size_t t = 0, pos = 0; t < VanTypeCount; pos += count[t++])
+        start[t] = next[t] = pos;
+
+    // Group the capacity column by type in place (American flag sort). Occupancy is
+    // recomputed from the per-type totals, so that column does not need to follow.
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        while (next[t] < start[t] + count[t]) {
+            size_t other = static_cast<size_t>(types_[next[t]]);
+            if (other == t) {
+                ++next[t];
+                continue;
             }
+            std::swap(capacities_[next[t]], capacities_[next[other]]);
+            std::swap(types_[next[t]], types_[next[other]]);
+            ++next[other];
         }
     }
-    size_t groupNewCount[NUM_TYPES];
-    for (size_t i = 0; i < NUM_TYPES; ++i) {
-        if (!groups[i].infos) {
-            groupNewCount[i] = 0;
-            continue;
-        }
-        if (types[i] == VanType::Restaurant) {
-            groupNewCount[i] = groups[i].count;
+
+    size_t kept[VanTypeCount];
+    auto pack = [&](size_t t) {
+        if (static_cast<VanType>(t) == VanType::Restaurant) {
+            std::fill_n(occupied_ + start[t], count[t], 0);
+            kept[t] = count[t];
         } else {
-            for (size_t a = 0; a < groups[i].count; ++a) {
-                size_t maxIdx = a;
-                for (size_t b = a + 1; b < groups[i].count; ++b) {
-                    if (groups[i].infos[b].capacity > groups[i].infos[maxIdx].capacity)
-                        maxIdx = b;
-                }
-                if (maxIdx != a) {
-                    VanInfo tmp = groups[i].infos[a];
-                    groups[i].infos[a] = groups[i].infos[maxIdx];
-                    groups[i].infos[maxIdx] = tmp;
-                }
-            }
-            size_t required = 0, capSum = 0;
-            while (required < groups[i].count && capSum < groups[i].totalOccupancy) {
-                capSum += groups[i].infos[required].capacity;
-                required++;
-            }
-            groupNewCount[i] = required;
-            size_t remaining = groups[i].totalOccupancy;
-            for (size_t a = 0; a < required; ++a) {
-                size_t assign = (remaining > groups[i].infos[a].capacity) ? groups[i].infos[a].capacity : remaining;
-                groups[i].infos[a].occupied = assign;
-                remaining -= assign;
-            }
+            kept[t] = PackGroup(capacities_ + start[t], occupied_ + start[t], count[t], totalOccupancy[t]);
         }
+    };
+    size_t used = std::min(threads, VanTypeCount);
+    if (pool && used > 1) {
+        pool->ParallelFor(VanTypeCount, pack);
+    } else if (size_ >= PARALLEL_THRESHOLD && used > 1) {
+        // Thread w packs every used-th group starting from group w.
+        auto packEvery = [&](size_t w) {
+            for (size_t t = w; t < VanTypeCount; t += used)
+                pack(t);
+        };
+        // jthreads join when they go out of scope, also when starting a later one throws.
+        std::jthread workers[VanTypeCount - 1];
+        for (size_t w = 1; w < used; ++w)
+            workers[w - 1] = std::jthread(packEvery, w);
+        packEvery(0);
+        for (size_t w = 1; w < used; ++w)
+            workers[w - 1].join();
+    } else {
+        for (size_t t = 0; t < VanTypeCount; ++t)
+            pack(t);
     }
-    size_t newTotal = 0;
-    for (size_t i = 0; i < NUM_TYPES; ++i)
-        newTotal += groupNewCount[i];
-    Van* newVans = new Van[newTotal];
+
     size_t pos = 0;
-    for (size_t i = 0; i < NUM_TYPES; ++i) {
-        if (!groups[i].infos)
-            continue;
-        if (types[i] == VanType::Restaurant) {
-            for (size_t a = 0; a < groups[i].count; ++a)
-                newVans[pos++] = Van(groups[i].infos[a].capacity, groups[i].infos[a].occupied, types[i]);
-        } else {
-            for (size_t a = 0; a < groupNewCount[i]; ++a)
-                newVans[pos++] = Van(groups[i].infos[a].capacity, groups[i].infos[a].occupied, types[i]);
-        }
-        delete[] groups[i].infos;
+    for (size_t t = 0; t < VanTypeCount; ++t) {
+        std::copy_n(capacities_ + start[t], kept[t], capacities_ + pos);
+        std::copy_n(occupied_ + start[t], kept[t], occupied_ + pos);
+        std::fill_n(types_ + pos, kept[t], static_cast<VanType>(t));
+        pos += kept[t];
     }
-    delete[] vans_;
-    vans_ = newVans;
-    size_ = newTotal;
-    capacity_ = newTotal;
+    size_ = pos;
+    FinishBulkChange(pool);
 }
 
 
-void Train::PlaceRestaurantVanOptimally() {
-    int restIndex = -1;
-    for (size_t i = 0; i < size_; ++i) {
-        if (vans_[i].GetType() == VanType::Restaurant) {
-            restIndex = static_cast<int>(i);
-            break;
-        }
+namespace {
+
+// sums[j] = passengers outside luxury vans among the first j + 1 vans; returns their total.
+size_t PassengerPrefix(const size_t* occupied, const VanType* types, size_t count, size_t* sums) noexcept {
+    size_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += types[i] == VanType::Luxury ? 0 : occupied[i];
+        sums[i] = sum;
+    }
+    return sum;
+}
+
+// Best place for the restaurant van at restIndex, given passenger prefix sums over the
+// whole train. prefix(j) sums the first j vans; lowerBound(x) is the smallest j with
+// prefix(j) >= x. The restaurant carries nobody, so the sums over the train without it
+// are these, skipping its slot. The result is the first split with the smallest
+// |left - right| = |2 * left - total|, which falls until left reaches total / 2 and
+// rises after: it is the first split past half, or the start of the plateau before it.
+template <typename Prefix, typename LowerBound>
+size_t BalancedSplit(size_t total, size_t restIndex, Prefix prefix, LowerBound lowerBound) {
+    auto splitOf = [restIndex](size_t count) { return count > restIndex ? count - 1 : count; };
+    auto leftOf = [&](size_t split) { return prefix(split >= restIndex ? split + 1 : split); };
+    size_t best = splitOf(lowerBound((total + 1) / 2));
+    if (best > 0) {
+        size_t below = leftOf(best - 1), above = leftOf(best);
+        if (total - 2 * below <= 2 * above - total)
+            best = splitOf(lowerBound(below));
+    }
+    return best;
+}
+
+// Cuts [0, count) into cuts + 1 segments whose passenger sums stay within limit, placing
+// each cut as early as possible. Returns false when limit is too small. prefix and
+// lowerBound are as for BalancedSplit.
+template <typename Prefix, typename LowerBound>
+bool CutWithin(size_t count, size_t limit, size_t* cuts, size_t cutCount, Prefix prefix, LowerBound lowerBound) {
+    size_t end = count;
+    for (size_t t = cutCount; t-- > 0;) {
+        size_t floor = prefix(end) > limit ? prefix(end) - limit : 0;
+        end = lowerBound(floor);
+        cuts[t] = end;
     }
-    if (restIndex == -1)
+    return prefix(end) <= limit;
+}
+
+// Parametric search for the smallest feasible walking load: O(k log n log S) queries.
+// Leaves the cuts for that load in `cuts`.
+template <typename Prefix, typename LowerBound>
+size_t SmallestLoad(size_t count, size_t total, size_t* cuts, size_t cutCount, Prefix prefix, LowerBound lowerBound) {
+    size_t lo = (total + cutCount) / (cutCount + 1), hi = total;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (CutWithin(count, mid, cuts, cutCount, prefix, lowerBound))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    CutWithin(count, lo, cuts, cutCount, prefix, lowerBound);
+    return lo;
+}
+
+} // namespace
+
+void Train::PlaceRestaurantVanOptimally(std::pmr::memory_resource* scratch) { PlaceRestaurantVanOptimally(scratch, nullptr); }
+
+void Train::PlaceRestaurantVanOptimally(ThreadPool& pool) { PlaceRestaurantVanOptimally(std::pmr::get_default_resource(), &pool); }
+
+void Train::PlaceRestaurantVanOptimally(std::pmr::memory_resource* scratch, ThreadPool* pool) {
+    if (totals_[VanType::Restaurant].vans == 0)
         return;
-    Van restaurantVan = vans_[restIndex];
-    for (size_t i = restIndex; i < size_ - 1; ++i)
-        vans_[i] = vans_[i + 1];
-    --size_;
-    size_t* cumSums = new size_t[size_ + 1];
-    cumSums[0] = 0;
+    size_t restIndex, bestIndex, total = totals_.NonLuxuryOccupied();
+    if (placementIndex_) {
+        const FenwickTree& passengers = placementIndex_->passengers;
+        restIndex = placementIndex_->restaurants.LowerBound(1) - 1;
+        bestIndex = BalancedSplit(total, restIndex,
+                                  [&](size_t count) { return passengers.Prefix(count); },
+                                  [&](size_t target) { return passengers.LowerBound(target); });
+    } else {
+        restIndex = static_cast<size_t>(std::find(types_, types_ + size_, VanType::Restaurant) - types_);
+        ScratchArray<size_t> buffer(scratch, size_ + 1);
+        size_t* cumSums = buffer.Get();
+        // Chunks scan their own prefix sums, then shift them by the passengers before them.
+        size_t chunks = ChunkCount(pool, size_);
+        ScratchArray<size_t> offsetBuffer(scratch, chunks);
+        size_t* offsets = offsetBuffer.Get();
+        cumSums[0] = 0;
+        ForChunks(pool, size_, chunks, [&](size_t chunk, size_t first, size_t last) {
+            offsets[chunk] = PassengerPrefix(occupied_ + first, types_ + first, last - first, cumSums + first + 1);
+        });
+        for (size_t chunk = 1; chunk < chunks; ++chunk)
+            offsets[chunk] += offsets[chunk - 1];
+        ForChunks(pool, size_, chunks, [&](size_t chunk, size_t first, size_t last) {
+            if (chunk > 0)
+                std::for_each(cumSums + first + 1, cumSums + last + 1, [&](size_t& sum) { sum += offsets[chunk - 1]; });
+        });
+        bestIndex = BalancedSplit(total, restIndex,
+                                  [&](size_t count) { return cumSums[count]; },
+                                  [&](size_t target) { return static_cast<size_t>(std::lower_bound(cumSums, cumSums + size_ + 1, target) - cumSums); });
+    }
+    MoveVan(restIndex, bestIndex);
+}
+
+size_t Train::PlaceRestaurantVansOptimally(std::pmr::memory_resource* scratch) {
+    size_t restaurants = totals_[VanType::Restaurant].vans;
+    if (restaurants == 0)
+        return 0;
+    ScratchArray<size_t> cutBuffer(scratch, restaurants);
+    size_t* cuts = cutBuffer.Get();
+    size_t lo = 0, total = totals_.NonLuxuryOccupied();
+    if (placementIndex_) {
+        // Restaurants weigh nothing in the passenger sums, so the search runs on the train
+        // as it stands; each cut is then counted in seating vans before it.
+        const FenwickTree& passengers = placementIndex_->passengers;
+        lo = SmallestLoad(size_, total, cuts, restaurants,
+                          [&](size_t count) { return passengers.Prefix(count); },
+                          [&](size_t target) { return passengers.LowerBound(target); });
+        for (size_t t = 0; t < restaurants; ++t)
+            cuts[t] -= placementIndex_->restaurants.Prefix(cuts[t]);
+    }
+    size_t seated = 0;
     for (size_t i = 0; i < size_; ++i) {
-        size_t cnt = (vans_[i].GetType() == VanType::Luxury) ? 0 : vans_[i].GetOccupiedSeats();
-        cumSums[i + 1] = cumSums[i] + cnt;
-    }
-    size_t total = cumSums[size_];
-    size_t bestIndex = 0, bestDiff = total;
-    for (size_t k = 0; k <= size_; ++k) {
-        size_t left = cumSums[k];
-        size_t right = total - left;
-        size_t diff = (left > right) ? left - right : right - left;
-        if (diff < bestDiff) {
-            bestDiff = diff;
-            bestIndex = k;
+        if (types_[i] != VanType::Restaurant)
+            MoveSlot(i, seated++);
+    }
+    if (!placementIndex_) {
+        ScratchArray<size_t> sumBuffer(scratch, seated + 1);
+        size_t* cumSums = sumBuffer.Get();
+        cumSums[0] = 0;
+        PassengerPrefix(occupied_, types_, seated, cumSums + 1);
+        lo = SmallestLoad(seated, total, cuts, restaurants,
+                          [&](size_t count) { return cumSums[count]; },
+                          [&](size_t target) { return static_cast<size_t>(std::lower_bound(cumSums, cumSums + seated + 1, target) - cumSums); });
+    }
+
+    // Spread the vans back out from the end, dropping restaurant vans in at the cuts.
+    for (size_t dst = size_, src = seated, t = restaurants; dst-- > 0;) {
+        if (t > 0 && cuts[t - 1] == src) {
+            capacities_[dst] = 0;
+            occupied_[dst] = 0;
+            types_[dst] = VanType::Restaurant;
+            --t;
+        } else {
+            MoveSlot(--src, dst);
         }
     }
-    delete[] cumSums;
-    for (size_t i = size_; i > bestIndex; --i)
-        vans_[i] = vans_[i - 1];
-    vans_[bestIndex] = restaurantVan;
-    ++size_;
+    Rehash();
+    RebuildIndexes();
+    return lo;
 }
 
 } // namespace mgt
@@ -1,21 +1,103 @@
+#ifndef TRAIN_HPP_
+#define TRAIN_HPP_
+
 #include "../van/van.hpp"
+#include "occupancy_stats.hpp"
+#include "seat_index.hpp"
+#include "fenwick_tree.hpp"
 #include <stdexcept>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 namespace mgt {
 
+class ThreadPool;
+
+// Vans are stored column-wise: capacity, occupancy and type each live in their own
+// contiguous array, so scans that need one attribute touch only that column.
 class Train {
 private:
-    Van* vans_;
+    size_t* capacities_;
+    size_t* occupied_;
+    VanType* types_;
     size_t size_;
     size_t capacity_;
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+    std::unique_ptr<SeatIndex> seatIndex_;
+    OccupancyStats totals_;
+    uint64_t hash_ = 0; // sum of VanHash over all vans, kept in step with totals_
+
+    // Prefix sums in consist order: passengers outside luxury vans, and restaurant vans.
+    struct PlacementIndex {
+        FenwickTree passengers;
+        FenwickTree restaurants;
+    };
+    std::unique_ptr<PlacementIndex> placementIndex_;
+
+public:
+    // Trains up to this many vans keep their columns inside the object and never allocate.
+    static constexpr size_t InlineVans = 16;
+
+private:
+    // All three columns share one uninitialized block: capacities, then occupancy, then types.
+    static constexpr size_t BytesPerVan = 2 * sizeof(size_t) + sizeof(VanType);
+
+    alignas(size_t) std::byte inline_[InlineVans * BytesPerVan];
+
+    size_t* InlineBlock() noexcept { return reinterpret_cast<size_t*>(inline_); }
+
+    [[nodiscard]] bool IsInline() const noexcept { return capacities_ == reinterpret_cast<const size_t*>(inline_); }
+
+    // Storage capacity for `count` vans; nothing smaller than the inline block is ever used.
+    static size_t StorageFor(size_t count) noexcept { return std::max(count, InlineVans); }
+
+    // `storage` comes from StorageFor: the inline block, or a heap block from the resource.
+    size_t* Allocate(size_t storage) {
+        return storage > InlineVans ? static_cast<size_t*>(resource_->allocate(storage * BytesPerVan, alignof(size_t))) : InlineBlock();
+    }
+
+    void Adopt(size_t* block, size_t storage) noexcept {
+        capacities_ = block;
+        occupied_ = block + storage;
+        types_ = reinterpret_cast<VanType*>(block + 2 * storage);
+        capacity_ = storage;
+    }
+
+    void Release() noexcept {
+        if (capacities_ && !IsInline())
+            resource_->deallocate(capacities_, capacity_ * BytesPerVan, alignof(size_t));
+        capacities_ = nullptr;
+        occupied_ = nullptr;
+        types_ = nullptr;
+    }
+
+    void CopyColumns(const Train& other) noexcept {
+        std::copy_n(other.capacities_, other.size_, capacities_);
+        std::copy_n(other.occupied_, other.size_, occupied_);
+        std::copy_n(other.types_, other.size_, types_);
+    }
 
     void Resize(size_t newSize) {
-        Van* temp = new Van[newSize];
-        std::copy_n(vans_, size_, temp);
-        delete[] vans_;
-        vans_ = temp;
-        capacity_ = newSize;
+        size_t storage = StorageFor(newSize);
+        if (storage == capacity_)
+            return;
+        size_t* block = Allocate(storage);
+        std::copy_n(capacities_, size_, block);
+        std::copy_n(occupied_, size_, block + storage);
+        std::copy_n(types_, size_, reinterpret_cast<VanType*>(block + 2 * storage));
+        Release();
+        Adopt(block, storage);
     }
 
     void Expand() {
@@ -26,96 +108,655 @@ private:
         Resize(capacity_ / 2);
     }
 
+    // Shrinks only once the train is down to a quarter of its storage, so alternating
+    // += and RemoveVan around a power of two does not reallocate on every call.
     void CheckResize() {
-        if (capacity_ / 2 == size_)
+        if (capacity_ > InlineVans && size_ <= capacity_ / 4)
             Shrink();
     }
 
+    // Leaves a moved-from train empty on its inline block.
+    void Reset() noexcept {
+        Adopt(InlineBlock(), InlineVans);
+        size_ = 0;
+        totals_ = {};
+        hash_ = 0;
+    }
+
+    void Store(size_t index, const Van& van) noexcept {
+        capacities_[index] = van.GetCapacity();
+        occupied_[index] = van.GetOccupiedSeats();
+        types_[index] = van.GetType();
+    }
+
+    // splitmix64's finalizer.
+    static constexpr uint64_t MixBits(uint64_t x) noexcept {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+        return x ^ (x >> 31);
+    }
+
+    // One van's term of the content hash. The position is mixed in, so the sum over all
+    // vans depends on their order, and a van can be added or taken out of it in O(1).
+    [[nodiscard]] uint64_t VanHash(size_t index) const noexcept {
+        uint64_t hash = MixBits(index + 0x9e3779b97f4a7c15);
+        hash = MixBits(hash ^ capacities_[index]);
+        hash = MixBits(hash ^ occupied_[index]);
+        return MixBits(hash ^ static_cast<uint64_t>(types_[index]));
+    }
+
+    void Rehash() noexcept {
+        hash_ = 0;
+        for (size_t i = 0; i < size_; ++i)
+            hash_ += VanHash(i);
+    }
+
+    // Adds or removes one van's contribution to the running per-type totals and the hash.
+    void Count(size_t index) noexcept {
+        TypeStats& stat = totals_.types[static_cast<size_t>(types_[index])];
+        ++stat.vans;
+        stat.capacity += capacities_[index];
+        stat.occupied += occupied_[index];
+        totals_.seatingVans += capacities_[index] > 0;
+        hash_ += VanHash(index);
+    }
+
+    void Uncount(size_t index) noexcept {
+        TypeStats& stat = totals_.types[static_cast<size_t>(types_[index])];
+        --stat.vans;
+        stat.capacity -= capacities_[index];
+        stat.occupied -= occupied_[index];
+        totals_.seatingVans -= capacities_[index] > 0;
+        hash_ -= VanHash(index);
+    }
+
+    void RecountTotals() noexcept {
+        totals_ = SumOccupancy(capacities_, occupied_, types_, size_);
+        Rehash();
+    }
+
+    // Same totals and hash, summed over chunks on pool when there is one.
+    void RecountTotals(ThreadPool* pool);
+
+    [[nodiscard]] size_t PlacementWeight(size_t index) const noexcept {
+        return types_[index] == VanType::Luxury ? 0 : occupied_[index];
+    }
+
+    // Takes one van out of / puts it back into the placement prefix sums.
+    void Unplace(size_t index) noexcept {
+        if (placementIndex_) {
+            placementIndex_->passengers.Add(index, 0 - PlacementWeight(index));
+            placementIndex_->restaurants.Add(index, 0 - static_cast<size_t>(types_[index] == VanType::Restaurant));
+        }
+    }
+
+    void Place(size_t index) noexcept {
+        if (placementIndex_) {
+            placementIndex_->passengers.Add(index, PlacementWeight(index));
+            placementIndex_->restaurants.Add(index, types_[index] == VanType::Restaurant);
+        }
+    }
+
+    // Overwrites an existing van and keeps the indexes and totals in step.
+    void Assign(size_t index, const Van& van) {
+        if (seatIndex_)
+            seatIndex_->Update(index, capacities_[index], occupied_[index], van.GetCapacity(), van.GetOccupiedSeats());
+        Uncount(index);
+        Unplace(index);
+        Store(index, van);
+        Count(index);
+        Place(index);
+    }
+
+    // The seat index is sized by capacity, so changing only the occupancy never allocates.
+    void SetOccupied(size_t index, size_t occupied) noexcept {
+        if (seatIndex_)
+            seatIndex_->Update(index, capacities_[index], occupied_[index], capacities_[index], occupied);
+        TypeStats& stat = totals_.types[static_cast<size_t>(types_[index])];
+        stat.occupied = stat.occupied - occupied_[index] + occupied;
+        Unplace(index);
+        hash_ -= VanHash(index);
+        occupied_[index] = occupied;
+        hash_ += VanHash(index);
+        Place(index);
+    }
+
+    void RebuildIndexes();
+
+    // After a bulk change to the columns: recounts the totals, rebuilds the indexes and,
+    // if the train is down to a quarter of its storage, shrinks it with one reallocation.
+    void FinishBulkChange(ThreadPool* pool = nullptr);
+
+    // Moves one van to position `to`, shifting the vans in between by one place.
+    void MoveVan(size_t from, size_t to);
+
+    // The columns only ever hold valid vans.
+    [[nodiscard]] Van Load(size_t index) const noexcept {
+        return Van::CreateUnchecked(capacities_[index], occupied_[index], types_[index]);
+    }
+
+    void MoveSlot(size_t from, size_t to) noexcept {
+        capacities_[to] = capacities_[from];
+        occupied_[to] = occupied_[from];
+        types_[to] = types_[from];
+    }
+
 public:
-    Train() noexcept : vans_(new Van[1]), size_(0), capacity_(1) {}
+    // Reference to a single van of a train. Reads go straight to the columns,
+    // writes are validated by Van and then scattered back.
+    class VanRef {
+    private:
+        Train* train_;
+        size_t index_;
+
+    public:
+        VanRef(Train* train, size_t index) noexcept : train_(train), index_(index) {}
+        VanRef(const VanRef& other) noexcept = default;
+
+        operator Van() const { return train_->Load(index_); }
+
+        VanRef& operator=(const Van& van) {
+            train_->Assign(index_, van);
+            return *this;
+        }
+
+        VanRef& operator=(const VanRef& other) {
+            return *this = static_cast<Van>(other);
+        }
+
+        [[nodiscard]] size_t GetCapacity() const noexcept { return train_->capacities_[index_]; }
+        [[nodiscard]] size_t GetOccupiedSeats() const noexcept { return train_->occupied_[index_]; }
+        [[nodiscard]] VanType GetType() const noexcept { return train_->types_[index_]; }
+        [[nodiscard]] size_t OccupancyRate() const { return static_cast<Van>(*this).OccupancyRate(); }
+
+        // Non-throwing forms of the setters below; on error the van is left unchanged.
+        std::expected<void, VanError> TrySetCapacity(size_t capacity) {
+            Van van = *this;
+            auto result = van.TrySetCapacity(capacity);
+            if (result)
+                *this = van;
+            return result;
+        }
+
+        std::expected<void, VanError> TrySetOccupiedSeats(size_t occupiedSeats) noexcept {
+            if (occupiedSeats > GetCapacity())
+                return std::unexpected(VanError::OverCapacity);
+            train_->SetOccupied(index_, occupiedSeats);
+            return {};
+        }
+
+        std::expected<void, VanError> TrySetType(VanType type) {
+            Van van = *this;
+            auto result = van.TrySetType(type);
+            if (result)
+                *this = van;
+            return result;
+        }
+
+        std::expected<void, VanError> TryAddPassengers(size_t count) noexcept {
+            size_t occupied = GetOccupiedSeats();
+            if (count > GetCapacity() - occupied)
+                return std::unexpected(VanError::OverCapacity);
+            train_->SetOccupied(index_, occupied + count);
+            return {};
+        }
+
+        std::expected<void, VanError> TryTransfer(VanRef other) {
+            Van self = *this, van = other;
+            auto result = self.TryTransfer(van);
+            if (result) {
+                *this = self;
+                other = van;
+            }
+            return result;
+        }
+
+        void SetCapacity(size_t capacity) {
+            if (auto result = TrySetCapacity(capacity); !result)
+                ThrowVanError(result.error());
+        }
+
+        void SetOccupiedSeats(size_t occupiedSeats) {
+            if (auto result = TrySetOccupiedSeats(occupiedSeats); !result)
+                ThrowVanError(result.error());
+        }
+
+        void SetType(VanType type) {
+            if (auto result = TrySetType(type); !result)
+                ThrowVanError(result.error());
+        }
+
+        void AddPassengers(size_t count) {
+            if (auto result = TryAddPassengers(count); !result)
+                ThrowVanError(result.error());
+        }
+
+        void RemovePassengers(size_t count) noexcept {
+            size_t occupied = GetOccupiedSeats();
+            train_->SetOccupied(index_, (occupied < count) ? 0 : occupied - count);
+        }
+
+        VanRef& operator+=(size_t count) {
+            AddPassengers(count);
+            return *this;
+        }
+
+        VanRef& operator-=(size_t count) noexcept {
+            RemovePassengers(count);
+            return *this;
+        }
+
+        VanRef& operator>>(VanRef other) {
+            if (auto result = TryTransfer(other); !result)
+                ThrowVanError(result.error());
+            return *this;
+        }
+
+        bool operator==(const VanRef& other) const { return static_cast<Van>(*this) == static_cast<Van>(other); }
+        bool operator==(const Van& other) const { return static_cast<Van>(*this) == other; }
+
+        friend std::ostream& operator<<(std::ostream& os, const VanRef& van) noexcept {
+            return os << static_cast<Van>(van);
+        }
+    };
+
+    // Random-access iterator over the vans. The columns hold no Van objects, so dereferencing
+    // yields a Van by value (const) or a VanRef proxy (mutable) rather than a real reference;
+    // the iterator models std::random_access_iterator but not the legacy forward iterator
+    // requirements. Bulk numeric work should use the contiguous column spans instead.
+    template <bool Const>
+    class BasicIterator {
+    private:
+        using TrainType = std::conditional_t<Const, const Train, Train>;
+
+        TrainType* train_ = nullptr;
+        size_t index_ = 0;
+
+        friend class BasicIterator<!Const>;
+
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Van;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, Van, VanRef>;
+
+        BasicIterator() noexcept = default;
+        BasicIterator(TrainType* train, size_t index) noexcept : train_(train), index_(index) {}
+
+        template <bool OtherConst>
+            requires(Const && !OtherConst)
+        BasicIterator(const BasicIterator<OtherConst>& other) noexcept : train_(other.train_), index_(other.index_) {}
+
+        reference operator*() const noexcept {
+            if constexpr (Const)
+                return train_->Load(index_);
+            else
+                return VanRef(train_, index_);
+        }
+
+        reference operator[](difference_type offset) const noexcept { return *(*this + offset); }
+
+        BasicIterator& operator++() noexcept {
+            ++index_;
+            return *this;
+        }
+
+        BasicIterator operator++(int) noexcept {
+            BasicIterator old = *this;
+            ++index_;
+            return old;
+        }
+
+        BasicIterator& operator--() noexcept {
+            --index_;
+            return *this;
+        }
+
+        BasicIterator operator--(int) noexcept {
+            BasicIterator old = *this;
+            --index_;
+            return old;
+        }
+
+        BasicIterator& operator+=(difference_type offset) noexcept {
+            index_ += static_cast<size_t>(offset);
+            return *this;
+        }
+
+        BasicIterator& operator-=(difference_type offset) noexcept {
+            index_ -= static_cast<size_t>(offset);
+            return *this;
+        }
+
+        friend BasicIterator operator+(BasicIterator it, difference_type offset) noexcept { return it += offset; }
+        friend BasicIterator operator+(difference_type offset, BasicIterator it) noexcept { return it += offset; }
+        friend BasicIterator operator-(BasicIterator it, difference_type offset) noexcept { return it -= offset; }
 
-    Train(const Van* ptr, size_t size) : vans_(new Van[size]), size_(size), capacity_(size) {
-        std::copy_n(ptr, size, vans_);
+        friend difference_type operator-(const BasicIterator& a, const BasicIterator& b) noexcept {
+            return static_cast<difference_type>(a.index_ - b.index_);
+        }
+
+        friend bool operator==(const BasicIterator& a, const BasicIterator& b) noexcept { return a.index_ == b.index_; }
+        friend auto operator<=>(const BasicIterator& a, const BasicIterator& b) noexcept { return a.index_ <=> b.index_; }
+    };
+
+    using Iterator = BasicIterator<false>;
+    using ConstIterator = BasicIterator<true>;
+
+    Train() noexcept : Train(std::pmr::get_default_resource()) {}
+
+    // Column storage beyond InlineVans comes from `resource`. Copies use the default resource
+    // unless given one; a move hands heap storage over together with the resource that owns it.
+    explicit Train(std::pmr::memory_resource* resource) noexcept
+        : capacities_(nullptr), occupied_(nullptr), types_(nullptr), size_(0), capacity_(0), resource_(resource) {
+        Adopt(InlineBlock(), InlineVans);
     }
 
-    Train(const Van& van) : vans_(new Van[1]), size_(1), capacity_(1) {
-        vans_[0] = van;
+    Train(const Van* ptr, size_t size, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : capacities_(nullptr), occupied_(nullptr), types_(nullptr), size_(size), capacity_(0), resource_(resource) {
+        Adopt(Allocate(StorageFor(size)), StorageFor(size));
+        for (size_t i = 0; i < size; ++i)
+            Store(i, ptr[i]);
+        RecountTotals();
     }
 
-    Train(const Train& other) : vans_(new Van[other.capacity_]), size_(other.size_), capacity_(other.capacity_) {
-        std::copy_n(other.vans_, size_, vans_);
+    Train(const Van& van, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : capacities_(nullptr), occupied_(nullptr), types_(nullptr), size_(1), capacity_(0), resource_(resource) {
+        Adopt(InlineBlock(), InlineVans);
+        Store(0, van);
+        Count(0);
     }
 
-    Train(Train&& other) noexcept : vans_(other.vans_), size_(other.size_), capacity_(other.capacity_) {
-        other.vans_ = nullptr;
-        other.size_ = 0;
-        other.capacity_ = 0;
+    Train(const Train& other, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : capacities_(nullptr), occupied_(nullptr), types_(nullptr), size_(other.size_), capacity_(0), resource_(resource),
+          seatIndex_(other.seatIndex_ ? std::make_unique<SeatIndex>(*other.seatIndex_) : nullptr), totals_(other.totals_),
+          hash_(other.hash_), placementIndex_(other.placementIndex_ ? std::make_unique<PlacementIndex>(*other.placementIndex_) : nullptr) {
+        Adopt(Allocate(StorageFor(size_)), StorageFor(size_));
+        CopyColumns(other);
+    }
+
+    // Copies the vans and totals but neither index, for copies that are only compared or
+    // copied again.
+    [[nodiscard]] Train CopyVans(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+        Train copy(resource);
+        copy.Reserve(size_);
+        copy.size_ = size_;
+        copy.CopyColumns(*this);
+        copy.totals_ = totals_;
+        copy.hash_ = hash_;
+        return copy;
+    }
+
+    // Inline columns cannot be stolen, so short trains are copied across.
+    Train(Train&& other) noexcept
+        : capacities_(nullptr), occupied_(nullptr), types_(nullptr), size_(other.size_), capacity_(0),
+          resource_(other.resource_), seatIndex_(std::move(other.seatIndex_)), totals_(other.totals_), hash_(other.hash_),
+          placementIndex_(std::move(other.placementIndex_)) {
+        if (other.IsInline()) {
+            Adopt(InlineBlock(), InlineVans);
+            CopyColumns(other);
+        } else {
+            Adopt(other.capacities_, other.capacity_);
+        }
+        other.Reset();
     }
 
     ~Train() {
-        delete[] vans_;
+        Release();
     }
 
     Train& operator=(const Train& other);
     Train& operator=(Train&& other) noexcept;
 
     bool operator==(const Train& other) const {
-        if (!vans_ || !other.vans_)
-            return vans_ == other.vans_;
-        return std::equal(vans_, vans_ + size_, other.vans_);
+        return size_ == other.size_
+            && std::equal(capacities_, capacities_ + size_, other.capacities_)
+            && std::equal(occupied_, occupied_ + size_, other.occupied_)
+            && std::equal(types_, types_ + size_, other.types_);
     }
 
     bool operator!=(const Train& other) const {
         return !(*this == other);
     }
 
-    Van& operator[](size_t index) {
+    VanRef operator[](size_t index) {
         if (index >= size_)
-            throw std::out_of_range("Index out of train range");
-        return vans_[index];
+            ThrowVanError(VanError::IndexOutOfRange);
+        return VanRef(this, index);
     }
 
-    const Van& operator[](size_t index) const {
+    Van operator[](size_t index) const {
         if (index >= size_)
-            throw std::out_of_range("Index out of train range");
-        return vans_[index];
+            ThrowVanError(VanError::IndexOutOfRange);
+        return Load(index);
+    }
+
+    [[nodiscard]] std::expected<VanRef, VanError> TryAt(size_t index) noexcept {
+        if (index >= size_)
+            return std::unexpected(VanError::IndexOutOfRange);
+        return VanRef(this, index);
+    }
+
+    [[nodiscard]] std::expected<Van, VanError> TryAt(size_t index) const noexcept {
+        if (index >= size_)
+            return std::unexpected(VanError::IndexOutOfRange);
+        return Load(index);
+    }
+
+    // No bounds check: for loops that already keep index below GetSize().
+    [[nodiscard]] VanRef UncheckedAt(size_t index) noexcept { return VanRef(this, index); }
+    [[nodiscard]] Van UncheckedAt(size_t index) const noexcept { return Load(index); }
+
+    // Makes room for at least `count` vans in total without changing the train.
+    void Reserve(size_t count) {
+        if (count > capacity_)
+            Resize(count);
+    }
+
+    void ShrinkToFit() {
+        if (capacity_ > size_)
+            Resize(size_);
+    }
+
+    [[nodiscard]] size_t GetStorageCapacity() const noexcept { return capacity_; }
+
+    [[nodiscard]] std::pmr::memory_resource* GetMemoryResource() const noexcept { return resource_; }
+
+    // Appends a range of vans; sized ranges grow the storage at most once.
+    template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+    Train& Append(It first, Sentinel last) {
+        if constexpr (std::forward_iterator<It>)
+            Reserve(size_ + static_cast<size_t>(std::ranges::distance(first, last)));
+        for (; first != last; ++first)
+            *this += static_cast<Van>(*first);
+        return *this;
+    }
+
+    template <std::ranges::input_range Range>
+    Train& Append(Range&& vans) {
+        return Append(std::ranges::begin(vans), std::ranges::end(vans));
     }
 
     Train& operator+=(const Van& van) {
         if (size_ == capacity_)
             Expand();
-        vans_[size_++] = van;
+        Store(size_, van);
+        Count(size_);
+        if (seatIndex_)
+            seatIndex_->Insert(size_, van.GetCapacity(), van.GetOccupiedSeats());
+        if (placementIndex_) {
+            placementIndex_->passengers.PushBack(PlacementWeight(size_));
+            placementIndex_->restaurants.PushBack(van.GetType() == VanType::Restaurant);
+        }
+        ++size_;
         return *this;
     }
 
     void RemoveVan(size_t index) {
+        if (auto result = TryRemoveVan(index); !result)
+            ThrowVanError(result.error());
+    }
+
+    std::expected<void, VanError> TryRemoveVan(size_t index) {
         if (index >= size_)
-            throw std::out_of_range("Index out of train range");
-        if (index != --size_)
-            vans_[index] = vans_[size_];
+            return std::unexpected(VanError::IndexOutOfRange);
+        if (seatIndex_)
+            seatIndex_->Erase(index, capacities_[index], occupied_[index]);
+        Uncount(index);
+        Unplace(index);
+        if (index != --size_) {
+            Unplace(size_);
+            hash_ -= VanHash(size_);
+            MoveSlot(size_, index);
+            hash_ += VanHash(index);
+            Place(index);
+            if (seatIndex_)
+                seatIndex_->Renumber(size_, index, capacities_[index], occupied_[index]);
+        }
+        if (placementIndex_) {
+            placementIndex_->passengers.PopBack();
+            placementIndex_->restaurants.PopBack();
+        }
         CheckResize();
+        return {};
     }
 
-    void SitInMin(size_t numOfPassengers);
-    void StaffingPercentage() noexcept;
+    // Order-preserving removal of every van for which pred(van) is true, in one pass over
+    // the columns. Returns the number of vans removed. If pred throws, the vans it had
+    // already picked are removed, the rest are kept, and the exception propagates.
+    template <typename Pred>
+    size_t EraseIf(Pred pred) {
+        size_t kept = 0, i = 0;
+        try {
+            for (; i < size_; ++i) {
+                if (!pred(Load(i))) {
+                    if (kept != i)
+                        MoveSlot(i, kept);
+                    ++kept;
+                }
+            }
+        } catch (...) {
+            if (kept != i) {
+                for (; i < size_; ++i)
+                    MoveSlot(i, kept++);
+                size_ = kept;
+                FinishBulkChange();
+            }
+            throw;
+        }
+        size_t removed = size_ - kept;
+        if (removed != 0) {
+            size_ = kept;
+            FinishBulkChange();
+        }
+        return removed;
+    }
 
-    size_t GetSize() const noexcept { return size_; }
+    // Removes vans [first, last) and closes the gap, keeping the order of the rest.
+    void EraseRange(size_t first, size_t last) {
+        if (auto result = TryEraseRange(first, last); !result)
+            ThrowVanError(result.error());
+    }
+
+    std::expected<void, VanError> TryEraseRange(size_t first, size_t last);
+
+    // Inserts the vans before position `pos` (GetSize() appends), moving the vans after it
+    // once and growing the storage at most once.
+    void InsertAt(size_t pos, std::span<const Van> vans) {
+        if (auto result = TryInsertAt(pos, vans); !result)
+            ThrowVanError(result.error());
+    }
+
+    std::expected<void, VanError> TryInsertAt(size_t pos, std::span<const Van> vans);
+
+    template <std::ranges::input_range Range>
+        requires(!std::convertible_to<Range, std::span<const Van>>)
+    void InsertAt(size_t pos, Range&& vans) {
+        if (pos > size_)
+            ThrowVanError(VanError::IndexOutOfRange);
+        std::vector<Van> buffer;
+        if constexpr (std::ranges::sized_range<Range>)
+            buffer.reserve(static_cast<size_t>(std::ranges::size(vans)));
+        for (auto&& van : vans)
+            buffer.push_back(static_cast<Van>(van));
+        InsertAt(pos, std::span<const Van>(buffer));
+    }
+
+    static constexpr size_t NotSeated = SeatIndex::npos;
 
-    void Write(std::ostream& os) const noexcept {
-        os << "{";
-        for (size_t i = 0; i < size_ - 1; ++i) {
-            os << vans_[i] << ", ";
+    // The van SitInMin would pick for the group, without seating it, or NotSeated.
+    [[nodiscard]] size_t FindBestFit(size_t numOfPassengers) const noexcept;
+
+    // Seats the group in the least occupied van that can hold it. Returns the van index, or NotSeated.
+    size_t SitInMin(size_t numOfPassengers);
+
+    // Same as calling SitInMin for every group in order, but shares one SeatIndex across the batch.
+    std::vector<size_t> SitInMinBatch(std::span<const size_t> groups);
+
+    // Keeps a SeatIndex up to date on every mutation so SitInMin runs in O(log n)
+    // instead of scanning the train. Off by default; copies and moves carry it along.
+    void EnableSeatIndex() {
+        if (!seatIndex_)
+            seatIndex_ = std::make_unique<SeatIndex>(capacities_, occupied_, size_);
+    }
+
+    void DisableSeatIndex() noexcept { seatIndex_.reset(); }
+
+    [[nodiscard]] bool HasSeatIndex() const noexcept { return seatIndex_ != nullptr; }
+
+    // Keeps Fenwick trees over non-luxury passengers and restaurant positions so that
+    // PlaceRestaurantVanOptimally finds its split in O(log n) instead of rebuilding prefix sums.
+    void EnablePlacementIndex() {
+        if (!placementIndex_) {
+            placementIndex_ = std::make_unique<PlacementIndex>();
+            RebuildIndexes();
         }
-        os << vans_[size_ - 1] << "}";
     }
 
-    void Read(std::istream& is) noexcept {
-        Van temp;
-        is >> temp;
-        if (is)
-            *this = Train(temp);
+    void DisablePlacementIndex() noexcept { placementIndex_.reset(); }
+
+    [[nodiscard]] bool HasPlacementIndex() const noexcept { return placementIndex_ != nullptr; }
+
+    // Per-type capacity/occupancy totals, see OccupancyStats::Percentage for the staffing figure.
+    // The totals are kept up to date by every mutation, so this is O(1).
+    [[nodiscard]] const OccupancyStats& StaffingPercentage() const noexcept {
+        return totals_;
+    }
+
+    // Writes Van::OccupancyRate of every van into rates[0 .. GetSize()).
+    void OccupancyRates(size_t* rates) const noexcept {
+        ComputeOccupancyRates(capacities_, occupied_, size_, rates);
     }
 
+    size_t GetSize() const noexcept { return size_; }
+
+    // Hash of every van's capacity, occupancy and type in consist order, kept up to date by
+    // every mutation so reading it is O(1). Equal trains hash equal whatever their memory
+    // resource or enabled indexes; std::hash<Train> returns it.
+    [[nodiscard]] uint64_t GetContentHash() const noexcept { return hash_; }
+
+    // Iterators are invalidated by anything that adds or removes vans.
+    Iterator begin() noexcept { return Iterator(this, 0); }
+    Iterator end() noexcept { return Iterator(this, size_); }
+    ConstIterator begin() const noexcept { return ConstIterator(this, 0); }
+    ConstIterator end() const noexcept { return ConstIterator(this, size_); }
+    ConstIterator cbegin() const noexcept { return begin(); }
+    ConstIterator cend() const noexcept { return end(); }
+
+    // Read-only views of the columns, valid until the next mutation. These are the contiguous
+    // ranges to hand to standard and parallel algorithms.
+    [[nodiscard]] std::span<const size_t> Capacities() const noexcept { return {capacities_, size_}; }
+    [[nodiscard]] std::span<const size_t> OccupiedSeats() const noexcept { return {occupied_, size_}; }
+    [[nodiscard]] std::span<const VanType> Types() const noexcept { return {types_, size_}; }
+
+    // "{o/c type, o/c type, ...}", or "{}" for an empty train.
+    void Write(std::ostream& os) const noexcept;
+
+    // Reads a whole manifest in Write format, or a single van as "o/c type". On failure
+    // the train is left unchanged and the stream's failbit is set.
+    void Read(std::istream& is) noexcept;
+
     friend std::ostream& operator<<(std::ostream& os, const Train& train) noexcept {
         train.Write(os);
         return os;
@@ -126,50 +767,75 @@ public:
         return is;
     }
 
+public:
+
+// The optimizers that need scratch arrays also take a resource to draw them from. Passing
+// a std::pmr::monotonic_buffer_resource that is released between trains keeps them off
+// the global heap; the overloads without one use the default resource.
+void BalanceOccupancy() { BalanceOccupancy(std::pmr::get_default_resource()); }
+void BalanceOccupancy(std::pmr::memory_resource* scratch);
+
+// Large trains pack their type groups on up to `threads` threads, the calling thread
+// included. Callers that already run trains in parallel, like Fleet, pass 1.
+void MinimizeVans() { MinimizeVans(VanTypeCount); }
+void MinimizeVans(size_t threads);
+
+void PlaceRestaurantVanOptimally() { PlaceRestaurantVanOptimally(std::pmr::get_default_resource()); }
+void PlaceRestaurantVanOptimally(std::pmr::memory_resource* scratch);
+
+// Moves every restaurant van so that they cut the non-luxury passengers into segments
+// with the smallest possible maximum load, and returns that load. Cuts go as early as
+// the optimum allows; with one restaurant van this is PlaceRestaurantVanOptimally.
+size_t PlaceRestaurantVansOptimally() { return PlaceRestaurantVansOptimally(std::pmr::get_default_resource()); }
+size_t PlaceRestaurantVansOptimally(std::pmr::memory_resource* scratch);
+
+// The same passes with their per-van loops split into chunks that run on pool, for trains
+// too large to leave on one thread. The result is exactly that of the overloads above.
+// Not to be called from a task running on the same pool.
+void BalanceOccupancy(ThreadPool& pool);
+void MinimizeVans(ThreadPool& pool);
+void PlaceRestaurantVanOptimally(ThreadPool& pool);
+
 private:
-struct Assignment {
-    size_t index;
-    size_t baseOccupancy;
-    double fraction;
-    size_t capacity;
+void BalanceOccupancy(std::pmr::memory_resource* scratch, ThreadPool* pool);
+void MinimizeVans(size_t threads, ThreadPool* pool);
+void PlaceRestaurantVanOptimally(std::pmr::memory_resource* scratch, ThreadPool* pool);
+
 };
 
-void swapAssignment(Assignment &a, Assignment &b) {
-    Assignment tmp = a;
-    a = b;
-    b = tmp;
-}
+} // namespace mgt
 
-int partitionAssignments(Assignment* arr, int low, int high) {
-    double pivot = arr[high].fraction;
-    int i = low - 1;
-    for (int j = low; j < high; ++j) {
-        if (arr[j].fraction > pivot) {
-            ++i;
-            swapAssignment(arr[i], arr[j]);
-        }
+// std::format("{}", train) gives the Write format; no format spec is accepted.
+template <>
+struct std::formatter<mgt::Train> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}')
+            throw std::format_error("mgt::Train takes no format spec");
+        return it;
     }
-    swapAssignment(arr[i + 1], arr[high]);
-    return i + 1;
-}
 
-void quickSortAssignments(Assignment* arr, int low, int high) {
-    if (low < high) {
-        int pi = partitionAssignments(arr, low, high);
-        quickSortAssignments(arr, low, pi - 1);
-        quickSortAssignments(arr, pi + 1, high);
+    auto format(const mgt::Train& train, std::format_context& ctx) const {
+        auto out = ctx.out();
+        *out++ = '{';
+        char buffer[mgt::MaxVanChars];
+        bool first = true;
+        for (mgt::Van van : train) {
+            if (!first) {
+                *out++ = ',';
+                *out++ = ' ';
+            }
+            first = false;
+            out = std::copy(buffer, mgt::FormatVan(buffer, van), out);
+        }
+        *out++ = '}';
+        return out;
     }
-}
-
-
-public:
-
-void BalanceOccupancy();
-
-void MinimizeVans();
-
-void PlaceRestaurantVanOptimally();
+};
 
+template <>
+struct std::hash<mgt::Train> {
+    size_t operator()(const mgt::Train& train) const noexcept { return static_cast<size_t>(train.GetContentHash()); }
 };
 
-} // namespace mgt
+#endif
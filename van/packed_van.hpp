@@ -0,0 +1,84 @@
+#ifndef PACKED_VAN_HPP_
+#define PACKED_VAN_HPP_
+
+#include "van.hpp"
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+namespace mgt {
+
+// Van squeezed into 32 bits for long-lived bulk records: just enough bits for the van
+// type, and the rest split evenly between occupied seats and capacity (15 bits each with
+// four types). Keeps the same invariants as Van and additionally rejects seat counts
+// above MaxSeats.
+class PackedVan {
+private:
+    static constexpr unsigned TypeBits = std::bit_width(VanTypeCount - 1);
+    static constexpr unsigned SeatBits = (32 - TypeBits) / 2;
+    static_assert(SeatBits >= 10, "too many van types to leave room for seat counts");
+
+    uint32_t bits_;
+
+    static constexpr uint32_t Pack(size_t capacity, size_t occupiedSeats, VanType type) noexcept {
+        return static_cast<uint32_t>(occupiedSeats) | static_cast<uint32_t>(capacity) << SeatBits
+             | static_cast<uint32_t>(type) << (2 * SeatBits);
+    }
+
+    static void CheckSeats(size_t seats) {
+        if (seats > MaxSeats)
+            throw std::out_of_range("Error: Seat count does not fit in a packed van.");
+    }
+
+public:
+    static constexpr size_t MaxSeats = (size_t{1} << SeatBits) - 1;
+
+    constexpr PackedVan() noexcept : bits_(Pack(0, 0, VanType::Restaurant)) {}
+
+    explicit PackedVan(size_t capacity, size_t occupiedSeats, VanType type) : bits_(0) {
+        CheckSeats(capacity);
+        if (auto valid = Van::Validate(capacity, occupiedSeats, type); !valid)
+            ThrowVanError(valid.error());
+        bits_ = Pack(capacity, occupiedSeats, type);
+    }
+
+    explicit PackedVan(const Van& van) : bits_(0) {
+        CheckSeats(van.GetCapacity());
+        bits_ = Pack(van.GetCapacity(), van.GetOccupiedSeats(), van.GetType());
+    }
+
+    [[nodiscard]] size_t GetCapacity() const noexcept { return bits_ >> SeatBits & MaxSeats; }
+    [[nodiscard]] size_t GetOccupiedSeats() const noexcept { return bits_ & MaxSeats; }
+    [[nodiscard]] VanType GetType() const noexcept { return static_cast<VanType>(bits_ >> (2 * SeatBits)); }
+
+    [[nodiscard]] Van ToVan() const noexcept { return Van::CreateUnchecked(GetCapacity(), GetOccupiedSeats(), GetType()); }
+    explicit operator Van() const noexcept { return ToVan(); }
+
+    // The setters apply Van's rules to the unpacked van and store the result.
+    void SetCapacity(size_t capacity) {
+        CheckSeats(capacity);
+        Van van = ToVan();
+        van.SetCapacity(capacity);
+        bits_ = Pack(van.GetCapacity(), van.GetOccupiedSeats(), van.GetType());
+    }
+
+    void SetOccupiedSeats(size_t occupiedSeats) {
+        Van van = ToVan();
+        van.SetOccupiedSeats(occupiedSeats);
+        bits_ = Pack(van.GetCapacity(), van.GetOccupiedSeats(), van.GetType());
+    }
+
+    void SetType(VanType type) {
+        Van van = ToVan();
+        van.SetType(type);
+        bits_ = Pack(van.GetCapacity(), van.GetOccupiedSeats(), van.GetType());
+    }
+
+    bool operator==(const PackedVan& other) const = default;
+};
+
+static_assert(sizeof(PackedVan) == 4);
+
+} // namespace mgt
+
+#endif
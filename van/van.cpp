@@ -1,20 +1,13 @@
 #include "van.hpp"
 #include <stdexcept>
-#include <exception>
+#include <charconv>
+#include <optional>
 
 namespace mgt {
 
-Van::Van(size_t capacity, size_t occupiedSeats, VanType type)
-    : capacity_(capacity), occupiedSeats_(occupiedSeats), type_(type) {
-    if (type_ == VanType::Restaurant && capacity_ != 0)
-        throw std::invalid_argument("Error: Restaurant van capacity must remain 0.");
-    if (occupiedSeats_ > capacity_)
-        throw std::invalid_argument("Error: Occupied seats exceed capacity.");
-}
-
-Van& Van::operator>>(Van& other) {
+std::expected<void, VanError> Van::TryTransfer(Van& other) noexcept {
     if (type_ != other.type_)
-        throw std::invalid_argument("Cannot transfer passengers between different van types.");
+        return std::unexpected(VanError::TypeMismatch);
     
     size_t totalCapacity = capacity_ + other.capacity_;
     size_t totalOccupied = occupiedSeats_ + other.occupiedSeats_;
@@ -24,26 +17,89 @@ Van& Van::operator>>(Van& other) {
     occupiedSeats_ = adjustedSeats;
     other.occupiedSeats_ = totalOccupied - adjustedSeats;
     
+    return {};
+}
+
+Van& Van::operator>>(Van& other) {
+    if (auto result = TryTransfer(other); !result)
+        ThrowVanError(result.error());
     return *this;
 }
 
+namespace {
+
+bool IsSpace(char c) noexcept { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// Parses "occupied/capacity" at text[pos], leaving pos on the first byte after the capacity digits.
+ParseStatus ParseSeats(std::string_view text, size_t& pos, size_t& occupiedSeats, size_t& capacity) noexcept {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    auto [afterOccupied, occupiedError] = std::from_chars(begin + pos, end, occupiedSeats);
+    if (occupiedError != std::errc())
+        return {pos, occupiedError == std::errc::result_out_of_range ? "seat count out of range" : "expected occupied seats"};
+    if (afterOccupied == end || *afterOccupied != '/')
+        return {static_cast<size_t>(afterOccupied - begin), "expected '/'"};
+    auto [afterCapacity, capacityError] = std::from_chars(afterOccupied + 1, end, capacity);
+    if (capacityError != std::errc())
+        return {static_cast<size_t>(afterOccupied + 1 - begin), capacityError == std::errc::result_out_of_range ? "seat count out of range" : "expected capacity"};
+    pos = static_cast<size_t>(afterCapacity - begin);
+    return {};
+}
+
+} // namespace
+
+ParseStatus ParseVan(std::string_view text, size_t& pos, Van& van) noexcept {
+    size_t cursor = pos, capacity, occupiedSeats;
+    if (ParseStatus status = ParseSeats(text, cursor, occupiedSeats, capacity); !status)
+        return status;
+    const char* end = text.data() + text.size();
+    const char* name = text.data() + cursor;
+    while (name != end && IsSpace(*name))
+        ++name;
+    if (name == text.data() + cursor)
+        return {cursor, "expected whitespace before the van type"};
+    const char* nameEnd = name;
+    while (nameEnd != end && !IsSpace(*nameEnd) && *nameEnd != ',' && *nameEnd != '}')
+        ++nameEnd;
+    std::optional<VanType> type = ParseVanType(std::string_view(name, static_cast<size_t>(nameEnd - name)));
+    if (!type)
+        return {static_cast<size_t>(name - text.data()), "unknown van type"};
+    if (auto valid = Van::Validate(capacity, occupiedSeats, *type); !valid)
+        return {pos, Describe(valid.error())};
+    van = Van::CreateUnchecked(capacity, occupiedSeats, *type);
+    pos = static_cast<size_t>(nameEnd - text.data());
+    return {};
+}
+
+char* FormatVan(char* out, const Van& van) noexcept {
+    const size_t DIGITS = std::numeric_limits<size_t>::digits10 + 1;
+    out = std::to_chars(out, out + DIGITS, van.GetOccupiedSeats()).ptr;
+    *out++ = '/';
+    out = std::to_chars(out, out + DIGITS, van.GetCapacity()).ptr;
+    *out++ = ' ';
+    std::string_view name = VanTypeTraits[static_cast<size_t>(van.GetType())].name;
+    return std::copy(name.begin(), name.end(), out);
+}
+
+void Van::Print(std::ostream& os) const noexcept {
+    char buffer[MaxVanChars];
+    os.write(buffer, FormatVan(buffer, *this) - buffer);
+}
+
 void Van::Read(std::istream& is) noexcept {
-    size_t capacity, occupiedSeats;
+    // Both tokens are a few bytes long and stay in the strings' inline buffers.
     std::string input, typeStr;
-    VanType tempType;
-    
     is >> input >> typeStr;
-    if (is) {
-        try {
-            size_t delimiter = input.find('/');
-            occupiedSeats = std::stoul(input.substr(0, delimiter));
-            capacity = std::stoul(input.substr(delimiter + 1));
-            tempType = StringToType.at(typeStr);
-            *this = Van(capacity, occupiedSeats, tempType);
-        } catch (const std::exception&) {
-            is.setstate(std::istream::failbit);
-        }
+    if (!is)
+        return;
+    // Like the stream extractors, anything after the capacity digits in the first token is ignored.
+    size_t pos = 0, capacity, occupiedSeats;
+    std::optional<VanType> type = ParseVanType(typeStr);
+    if (!ParseSeats(input, pos, occupiedSeats, capacity) || !type || !Van::Validate(capacity, occupiedSeats, *type)) {
+        is.setstate(std::istream::failbit);
+        return;
     }
+    *this = CreateUnchecked(capacity, occupiedSeats, *type);
 }
 
 } // namespace mgt
@@ -1,10 +1,17 @@
 #ifndef VAN_HPP_
 #define VAN_HPP_
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <string>
-#include <map>
+#include <string_view>
+#include <optional>
+#include <expected>
+#include <cstdint>
+#include <bit>
+#include <iterator>
+#include <limits>
 #include <format>
 
 namespace mgt {
@@ -16,79 +23,253 @@ enum class VanType {
     Luxury
 };
 
-const std::map<VanType, size_t> DefaultCapacity{
-    {VanType::Restaurant, 0},
-    {VanType::Seated, 78},
-    {VanType::Economy, 56},
-    {VanType::Luxury, 14}
+// Per-type constants, one row per VanType in enum order. A new van type is an enum
+// value plus a row here; the name lookup below is generated from this table, and
+// PackedVan's field widths and the SIMD statistics kernels follow VanTypeCount.
+// Snapshots and archives record the count and refuse files written with another one.
+struct VanTraits {
+    VanType type;
+    std::string_view name;
+    size_t defaultCapacity;
 };
 
-const std::map<VanType, std::string> TypeToString{
-    {VanType::Restaurant, "restaurant"},
-    {VanType::Seated, "seated"},
-    {VanType::Economy, "economy"},
-    {VanType::Luxury, "luxury"}
+inline constexpr VanTraits VanTypeTraits[] = {
+    {VanType::Restaurant, "restaurant", 0},
+    {VanType::Seated, "seated", 78},
+    {VanType::Economy, "economy", 56},
+    {VanType::Luxury, "luxury", 14}
 };
 
-const std::map<std::string, VanType> StringToType{
-    {"restaurant", VanType::Restaurant},
-    {"seated", VanType::Seated},
-    {"economy", VanType::Economy},
-    {"luxury", VanType::Luxury}
+inline constexpr size_t VanTypeCount = std::size(VanTypeTraits);
+
+constexpr const VanTraits& TraitsOf(VanType type) {
+    size_t index = static_cast<size_t>(type);
+    if (index >= VanTypeCount)
+        throw std::out_of_range("Error: Unknown van type.");
+    return VanTypeTraits[index];
+}
+
+constexpr size_t DefaultCapacityOf(VanType type) { return TraitsOf(type).defaultCapacity; }
+
+constexpr std::string_view ToString(VanType type) { return TraitsOf(type).name; }
+
+constexpr size_t LongestTypeName() noexcept {
+    size_t longest = 0;
+    for (const VanTraits& traits : VanTypeTraits)
+        longest = std::max(longest, traits.name.size());
+    return longest;
+}
+
+// Longest Print output: two seat counts, '/', ' ' and the longest type name.
+inline constexpr size_t MaxVanChars = 2 * (std::numeric_limits<size_t>::digits10 + 1) + 2 + LongestTypeName();
+
+namespace detail {
+
+constexpr bool TraitsInEnumOrder() noexcept {
+    for (size_t i = 0; i < VanTypeCount; ++i) {
+        if (static_cast<size_t>(VanTypeTraits[i].type) != i)
+            return false;
+    }
+    return true;
+}
+
+static_assert(TraitsInEnumOrder(), "VanTypeTraits rows must follow the VanType enum order");
+
+// Type names are looked up through a perfect hash: FNV-1a with a seed chosen at compile
+// time so that every name lands in its own slot of a power-of-two table.
+inline constexpr size_t NameSlots = std::bit_ceil(2 * VanTypeCount);
+inline constexpr uint8_t NoType = 0xFF;
+
+constexpr uint32_t HashName(std::string_view name, uint32_t seed) noexcept {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    return hash;
+}
+
+constexpr std::optional<uint32_t> FindNameSeed() noexcept {
+    for (uint32_t seed = 0; seed < (1u << 16); ++seed) {
+        bool used[NameSlots] = {};
+        bool distinct = true;
+        for (size_t i = 0; i < VanTypeCount && distinct; ++i) {
+            size_t slot = HashName(VanTypeTraits[i].name, seed) & (NameSlots - 1);
+            distinct = !used[slot];
+            used[slot] = true;
+        }
+        if (distinct)
+            return seed;
+    }
+    return std::nullopt;
+}
+
+static_assert(FindNameSeed().has_value(), "No perfect hash found for the van type names");
+inline constexpr uint32_t NameSeed = *FindNameSeed();
+
+struct NameTable {
+    uint8_t slots[NameSlots];
 };
 
+constexpr NameTable BuildNameTable() noexcept {
+    NameTable table{};
+    for (uint8_t& slot : table.slots)
+        slot = NoType;
+    for (size_t i = 0; i < VanTypeCount; ++i)
+        table.slots[HashName(VanTypeTraits[i].name, NameSeed) & (NameSlots - 1)] = static_cast<uint8_t>(i);
+    return table;
+}
+
+inline constexpr NameTable TypeNames = BuildNameTable();
+
+} // namespace detail
+
+// The type called `name` ("restaurant", "seated", ...), or nullopt for anything else.
+constexpr std::optional<VanType> ParseVanType(std::string_view name) noexcept {
+    uint8_t index = detail::TypeNames.slots[detail::HashName(name, detail::NameSeed) & (detail::NameSlots - 1)];
+    if (index == detail::NoType || VanTypeTraits[index].name != name)
+        return std::nullopt;
+    return static_cast<VanType>(index);
+}
+
+// Why a Van or Train mutation was refused. The Try* API returns these instead of
+// throwing; the throwing API raises ThrowVanError(error) for the same conditions.
+enum class VanError {
+    RestaurantCapacity,
+    OverCapacity,
+    OverNewCapacity,
+    TypeMismatch,
+    IndexOutOfRange
+};
+
+constexpr const char* Describe(VanError error) noexcept {
+    switch (error) {
+    case VanError::RestaurantCapacity: return "Error: Restaurant van capacity must remain 0.";
+    case VanError::OverCapacity: return "Error: Occupied seats exceed capacity.";
+    case VanError::OverNewCapacity: return "Error: Occupied seats exceed new capacity.";
+    case VanError::TypeMismatch: return "Cannot transfer passengers between different van types.";
+    case VanError::IndexOutOfRange: return "Index out of train range";
+    }
+    return "Unknown van error";
+}
+
+// std::out_of_range for a bad index, std::invalid_argument for everything else.
+[[noreturn]] inline void ThrowVanError(VanError error) {
+    if (error == VanError::IndexOutOfRange)
+        throw std::out_of_range(Describe(error));
+    throw std::invalid_argument(Describe(error));
+}
+
 class Van {
 private:
     size_t capacity_;
     size_t occupiedSeats_;
     VanType type_;
 
-    [[nodiscard]] size_t CalculateOccupancyRate(size_t occupiedSeats, size_t capacity) const noexcept {
+    [[nodiscard]] constexpr size_t CalculateOccupancyRate(size_t occupiedSeats, size_t capacity) const noexcept {
         return capacity_ ? static_cast<size_t>((static_cast<double>(occupiedSeats) / static_cast<double>(capacity)) * 100) : 0;
     }
 
 public:
-    Van() noexcept : capacity_(0), occupiedSeats_(0), type_(VanType::Restaurant) {}
+    constexpr Van() noexcept : capacity_(0), occupiedSeats_(0), type_(VanType::Restaurant) {}
+
+    constexpr explicit Van(size_t capacity, size_t occupiedSeats, VanType type)
+        : capacity_(capacity), occupiedSeats_(occupiedSeats), type_(type) {
+        if (auto valid = Validate(capacity, occupiedSeats, type); !valid)
+            ThrowVanError(valid.error());
+    }
 
-    explicit Van(size_t capacity, size_t occupiedSeats, VanType type);
+    constexpr explicit Van(VanType type)
+        : capacity_(DefaultCapacityOf(type)), occupiedSeats_(0), type_(type) {}
+
+    [[nodiscard]] static constexpr std::expected<void, VanError> Validate(size_t capacity, size_t occupiedSeats, VanType type) noexcept {
+        if (type == VanType::Restaurant && capacity != 0)
+            return std::unexpected(VanError::RestaurantCapacity);
+        if (occupiedSeats > capacity)
+            return std::unexpected(VanError::OverCapacity);
+        return {};
+    }
+
+    [[nodiscard]] static constexpr std::expected<Van, VanError> TryCreate(size_t capacity, size_t occupiedSeats, VanType type) noexcept {
+        if (auto valid = Validate(capacity, occupiedSeats, type); !valid)
+            return std::unexpected(valid.error());
+        return CreateUnchecked(capacity, occupiedSeats, type);
+    }
 
-    explicit Van(VanType type)
-        : capacity_(DefaultCapacity.at(type)), occupiedSeats_(0), type_(type) {}
+    // Skips Validate: for values that are already known to form a valid van.
+    [[nodiscard]] static constexpr Van CreateUnchecked(size_t capacity, size_t occupiedSeats, VanType type) noexcept {
+        Van van;
+        van.capacity_ = capacity;
+        van.occupiedSeats_ = occupiedSeats;
+        van.type_ = type;
+        return van;
+    }
 
-    [[nodiscard]] size_t GetCapacity() const noexcept { return capacity_; }
-    [[nodiscard]] size_t GetOccupiedSeats() const noexcept { return occupiedSeats_; }
-    [[nodiscard]] VanType GetType() const noexcept { return type_; }
-    [[nodiscard]] size_t OccupancyRate() const noexcept { return CalculateOccupancyRate(occupiedSeats_, capacity_); }
+    [[nodiscard]] constexpr size_t GetCapacity() const noexcept { return capacity_; }
+    [[nodiscard]] constexpr size_t GetOccupiedSeats() const noexcept { return occupiedSeats_; }
+    [[nodiscard]] constexpr VanType GetType() const noexcept { return type_; }
+    [[nodiscard]] constexpr size_t OccupancyRate() const noexcept { return CalculateOccupancyRate(occupiedSeats_, capacity_); }
 
-    void SetCapacity(size_t capacity) {
+    // Non-throwing setters: on error the van is left unchanged.
+    constexpr std::expected<void, VanError> TrySetCapacity(size_t capacity) noexcept {
         if (type_ == VanType::Restaurant && capacity != 0)
-            throw std::invalid_argument("Error: Restaurant van capacity must remain 0.");
+            return std::unexpected(VanError::RestaurantCapacity);
         if (occupiedSeats_ > capacity)
-            throw std::invalid_argument("Error: Occupied seats exceed new capacity.");
+            return std::unexpected(VanError::OverNewCapacity);
         capacity_ = capacity;
+        return {};
     }
 
-    void SetOccupiedSeats(size_t occupiedSeats) {
+    constexpr std::expected<void, VanError> TrySetOccupiedSeats(size_t occupiedSeats) noexcept {
         if (occupiedSeats > capacity_)
-            throw std::invalid_argument("Error: Occupied seats exceed capacity.");
+            return std::unexpected(VanError::OverCapacity);
         occupiedSeats_ = occupiedSeats;
+        return {};
     }
 
-    void SetType(VanType type) {
+    constexpr std::expected<void, VanError> TrySetType(VanType type) noexcept {
         if (type == VanType::Restaurant && capacity_ != 0)
-            throw std::invalid_argument("Error: Restaurant van capacity must remain 0.");
+            return std::unexpected(VanError::RestaurantCapacity);
         type_ = type;
+        return {};
     }
 
-    Van& operator>>(Van& other);
+    constexpr std::expected<void, VanError> TryAddPassengers(size_t count) noexcept {
+        if (count > capacity_ - occupiedSeats_)
+            return std::unexpected(VanError::OverCapacity);
+        occupiedSeats_ += count;
+        return {};
+    }
+
+    // operator>> without the exception: both vans are left unchanged on error.
+    std::expected<void, VanError> TryTransfer(Van& other) noexcept;
 
-    void AddPassengers(size_t count) { SetOccupiedSeats(occupiedSeats_ + count); }
-    void RemovePassengers(size_t count) noexcept { occupiedSeats_ = (occupiedSeats_ < count) ? 0 : occupiedSeats_ - count; }
+    constexpr void SetCapacity(size_t capacity) {
+        if (auto result = TrySetCapacity(capacity); !result)
+            ThrowVanError(result.error());
+    }
+
+    constexpr void SetOccupiedSeats(size_t occupiedSeats) {
+        if (auto result = TrySetOccupiedSeats(occupiedSeats); !result)
+            ThrowVanError(result.error());
+    }
 
-    void Print(std::ostream& os) const noexcept {
-        os << std::format("{}/{} {}", occupiedSeats_, capacity_, TypeToString.at(type_));
+    constexpr void SetType(VanType type) {
+        if (auto result = TrySetType(type); !result)
+            ThrowVanError(result.error());
     }
 
+    // For loops that have already checked the seats fit: no validation at all.
+    constexpr void SetOccupiedSeatsUnchecked(size_t occupiedSeats) noexcept { occupiedSeats_ = occupiedSeats; }
+
+    Van& operator>>(Van& other);
+
+    constexpr void AddPassengers(size_t count) {
+        if (auto result = TryAddPassengers(count); !result)
+            ThrowVanError(result.error());
+    }
+    constexpr void RemovePassengers(size_t count) noexcept { occupiedSeats_ = (occupiedSeats_ < count) ? 0 : occupiedSeats_ - count; }
+
+    void Print(std::ostream& os) const noexcept;
+
     void Read(std::istream& is) noexcept;
 
     friend std::istream& operator>>(std::istream& is, Van& van) noexcept {
@@ -101,19 +282,54 @@ public:
         return os;
     }
 
-    Van& operator+=(size_t count) {
+    constexpr Van& operator+=(size_t count) {
         AddPassengers(count);
         return *this;
     }
 
-    Van& operator-=(size_t count) noexcept {
+    constexpr Van& operator-=(size_t count) noexcept {
         RemovePassengers(count);
         return *this;
     }
 
-    bool operator==(const Van& other) const = default;
+    constexpr bool operator==(const Van& other) const = default;
+};
+
+// Outcome of a parse that does not throw. On failure `position` is the offset of the
+// offending byte and `message` says what was wrong there; success has no message.
+struct ParseStatus {
+    size_t position = 0;
+    const char* message = nullptr;
+
+    [[nodiscard]] bool Ok() const noexcept { return message == nullptr; }
+    explicit operator bool() const noexcept { return Ok(); }
 };
 
+// Renders `van` in Print format at `out`, which needs room for MaxVanChars, and returns
+// the end of the text. Does not allocate.
+char* FormatVan(char* out, const Van& van) noexcept;
+
+// Parses one van in Print format ("occupied/capacity type") starting at text[pos] and
+// advances pos past it. The type name ends at whitespace, ',', '}' or the end of text.
+ParseStatus ParseVan(std::string_view text, size_t& pos, Van& van) noexcept;
+
 }
 
+// std::format("{}", van) gives the Print format; no format spec is accepted.
+template <>
+struct std::formatter<mgt::Van> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}')
+            throw std::format_error("mgt::Van takes no format spec");
+        return it;
+    }
+
+    auto format(const mgt::Van& van, std::format_context& ctx) const {
+        char buffer[mgt::MaxVanChars];
+        char* end = mgt::FormatVan(buffer, van);
+        return std::copy(buffer, end, ctx.out());
+    }
+};
+
 #endif